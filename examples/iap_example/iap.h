@@ -25,6 +25,105 @@ const auto flash_write_option_data = reinterpret_cast<FlashWriteOptionFn>(0x1FFF
 typedef uint32_t (*Crc32CalcFn)(const uint8_t*, size_t);
 const auto crc32_calc = reinterpret_cast<Crc32CalcFn>(0x1FFFF018);
 
+
+/**
+ * Extended table, bootloader built with BOOT_FEATURE_IAP_PACKET.
+ * Same bus framing as the bootloader, the application answers its own
+ * commands with the bootloader parser. Check iap_packet_ok() before use.
+ */
+
+// Table id at 0x1FFFF01C, magic, bit 8 extended frames, bit 9 burst,
+// bit 10 packet functions, bit 11 warm entry, version. Fixed layout since
+// version 2, the slots of features not built are reserved.
+#define IAP_TABLE_ID_ADR        0x1FFFF01C
+#define IAP_TABLE_MAGIC         0x1A500000
+#define IAP_TABLE_EXT_FRAME     (1 << 8)
+#define IAP_TABLE_BURST         (1 << 9)
+#define IAP_TABLE_PACKET        (1 << 10)
+#define IAP_TABLE_WARM_ENTRY    (1 << 11)
+#define IAP_TABLE_VERSION       2
+
+inline uint32_t iap_table_id(){
+    return *reinterpret_cast<volatile const uint32_t*>(IAP_TABLE_ID_ADR);
+}
+
+// Packet_t of the bootloader (lib/packet/packet.h). The 16bit length and
+// 1030 byte buffer of extended frames are not supported here.
+struct IapPacket {
+    // Receive state, zero before the first byte.
+    uint8_t state;
+    uint8_t sync_count;
+    uint8_t ext_len;
+    uint8_t burst;
+    uint16_t index;
+    alignas(4) uint8_t crc_buf[4];
+    uint32_t crc_state;
+    uint32_t sync_total;
+
+    uint8_t type;
+    uint8_t command;
+    alignas(4) uint8_t address[8];
+    uint8_t addr_len;
+    uint8_t data_len;
+    alignas(4) uint8_t data[255];
+};
+
+inline bool iap_packet_ok(){
+    uint32_t id = iap_table_id();
+    return (id & 0xFFFF0000) == IAP_TABLE_MAGIC && (id & 0xFF) >= IAP_TABLE_VERSION
+        && (id & IAP_TABLE_PACKET) && !(id & IAP_TABLE_EXT_FRAME);
+}
+
+// uint8_t Packet_Update_Rx(uint8_t byte, Packet_t *pkt);
+// 1 when a request with valid CRC32 is complete in pkt.
+typedef uint8_t (*PacketUpdateRxFn)(uint8_t, IapPacket*);
+const auto packet_update_rx = reinterpret_cast<PacketUpdateRxFn>(0x1FFFF024);
+
+// uint32_t packet_serialize(uint8_t* buffer, uint8_t node_id, uint8_t cmd, uint8_t* data, uint8_t datalen);
+// Response frame with preamble and CRC32, buffer needs datalen + 13 bytes.
+typedef uint32_t (*PacketSerializeFn)(uint8_t*, uint8_t, uint8_t, uint8_t*, uint8_t);
+const auto packet_serialize = reinterpret_cast<PacketSerializeFn>(0x1FFFF028);
+
+// void uart_init(void);
+// USART1 half-duplex at 9600 bps (8MHz), clock and pin remap are done by the application.
+typedef void (*UartInitFn)(void);
+const auto uart_init = reinterpret_cast<UartInitFn>(0x1FFFF02C);
+
+// void uart_write(uint8_t ch);
+typedef void (*UartWriteFn)(uint8_t);
+const auto uart_write = reinterpret_cast<UartWriteFn>(0x1FFFF030);
+
+// uint32_t uart_available(void);
+typedef uint32_t (*UartAvailableFn)(void);
+const auto uart_available = reinterpret_cast<UartAvailableFn>(0x1FFFF034);
+
+// uint8_t uart_read(void);
+typedef uint8_t (*UartReadFn)(void);
+const auto uart_read = reinterpret_cast<UartReadFn>(0x1FFFF038);
+
+// void uart_set_brr(uint16_t brr);
+// BRR = 8MHz / baudrate.
+typedef void (*UartSetBrrFn)(uint16_t);
+const auto uart_set_brr = reinterpret_cast<UartSetBrrFn>(0x1FFFF03C);
+
+
+/**
+ * Warm entry, bootloader built with BOOT_FEATURE_WARM_ENTRY.
+ * Resets into the bootloader with the session already active, the host
+ * skips the sync hold (uploader --no-sync). Does not return.
+ * The last RAM word (0x200007FC) holds the request over the reset.
+ */
+
+inline bool iap_warm_entry_ok(){
+    uint32_t id = iap_table_id();
+    return (id & 0xFFFF0000) == IAP_TABLE_MAGIC && (id & 0xFF) >= IAP_TABLE_VERSION
+        && (id & IAP_TABLE_WARM_ENTRY);
+}
+
+// void boot_warm_entry(void);
+typedef void (*BootWarmEntryFn)(void);
+const auto boot_warm_entry = reinterpret_cast<BootWarmEntryFn>(0x1FFFF020);
+
 #endif // BSL_H
 
 
@@ -0,0 +1,239 @@
+//
+//Host benchmark for the packet/CRC hot path.
+//
+//Build and run on the host (x86-64 Linux):
+//  pio run -e native_bench -t exec
+//
+//The numbers are host numbers, use them to compare before/after a change
+//of packet.c or crc32.c, not as absolute target timing.
+//
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include "packet.h"
+#include "crc32.h"
+
+//Target amount of bytes to process per measurement.
+#define BENCH_BYTES         (8u * 1024u * 1024u)
+
+static const uint32_t payload_sizes[] = {0, 1, 4, 8, 16, 32, 64, 70, 128, 192, 255};
+#define PAYLOAD_SIZES_COUNT (sizeof(payload_sizes) / sizeof(payload_sizes[0]))
+
+static uint8_t frame[512];
+static uint8_t flash_image[16384];
+static Packet_t rx_pkt;
+
+//Keep results alive so the compiler do not remove the work.
+static volatile uint32_t sink;
+
+/**
+ * @brief Monotonic time in nanoseconds.
+ */
+static uint64_t now_ns(void){
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+/**
+ * @brief Build a REQUEST frame the same way the host uploader does.
+ * @return Total number of bytes in frame (including preambles).
+ */
+static uint32_t build_request(uint8_t* buf, const uint8_t* addr, uint8_t addr_len,
+    uint8_t cmd, const uint8_t* data, uint8_t datalen)
+{
+    uint32_t i = 0;
+
+    for(int p = 0; p < PREAMBLE_COUNT; p++){
+        buf[i++] = PREAMBLE_BYTE;
+    }
+
+    buf[i++] = HDR_MASK_BASE | ((addr_len == 8) ? HDR_FLAG_ADR_128BIT : 0) | PKT_TYPE_REQUEST;
+    for(uint8_t a = 0; a < addr_len; a++){
+        buf[i++] = addr[a];
+    }
+    buf[i++] = cmd;
+    buf[i++] = datalen;
+    for(uint32_t d = 0; d < datalen; d++){
+        buf[i++] = data[d];
+    }
+
+    uint32_t crc = crc32_calc(&buf[PREAMBLE_COUNT], i - PREAMBLE_COUNT);
+    buf[i++] = (uint8_t)(crc);
+    buf[i++] = (uint8_t)(crc >> 8);
+    buf[i++] = (uint8_t)(crc >> 16);
+    buf[i++] = (uint8_t)(crc >> 24);
+
+    return i;
+}
+
+/**
+ * @brief Fill buffer with payload that never contains the preamble byte.
+ */
+static void fill_payload(uint8_t* buf, uint32_t len){
+    for(uint32_t i = 0; i < len; i++){
+        uint8_t b = (uint8_t)(i * 37u + 11u);
+        buf[i] = (b == PREAMBLE_BYTE) ? 0x00 : b;
+    }
+}
+
+/**
+ * @brief Print one result row.
+ */
+static void report(const char* name, uint32_t size, uint32_t addr_len, uint64_t bytes, uint64_t ns){
+    double ns_per_byte = (double)ns / (double)bytes;
+    double bytes_per_s = (double)bytes * 1e9 / (double)ns;
+
+    printf("%-18s %8u %5u %12.2f %14.0f\n", name, size, addr_len, ns_per_byte, bytes_per_s);
+}
+
+/**
+ * @brief Feed complete request frames through Packet_Update_Rx.
+ */
+static void bench_update_rx(uint32_t datalen, uint8_t addr_len){
+    uint8_t payload[255];
+    const uint8_t addr[8] = {0x01, 0x23, 0x45, 0x67, 0x89, 0xAB, 0xCD, 0xEF};
+
+    fill_payload(payload, datalen);
+    uint32_t len = build_request(frame, addr, addr_len, 0x31, payload, (uint8_t)datalen);
+    uint32_t loops = BENCH_BYTES / len + 1;
+    uint32_t ok = 0;
+
+    uint64_t t0 = now_ns();
+    for(uint32_t l = 0; l < loops; l++){
+        for(uint32_t i = 0; i < len; i++){
+            ok += Packet_Update_Rx(frame[i], &rx_pkt);
+        }
+    }
+    uint64_t t1 = now_ns();
+
+    //Every frame must be accepted, else we are measuring the wrong path.
+    if(ok != loops){
+        printf("Packet_Update_Rx rejected frames (%u of %u accepted)\n", ok, loops);
+        exit(1);
+    }
+
+    report("Packet_Update_Rx", datalen, addr_len, (uint64_t)loops * len, t1 - t0);
+}
+
+/**
+ * @brief Serialize response frames.
+ */
+static void bench_serialize(uint32_t datalen){
+    uint8_t payload[255];
+
+    fill_payload(payload, datalen);
+    uint32_t len = packet_serialize(frame, 0x12, 0x31, payload, (uint8_t)datalen);
+    uint32_t loops = BENCH_BYTES / len + 1;
+
+    uint64_t t0 = now_ns();
+    for(uint32_t l = 0; l < loops; l++){
+        sink += packet_serialize(frame, 0x12, 0x31, payload, (uint8_t)datalen);
+    }
+    uint64_t t1 = now_ns();
+
+    report("packet_serialize", datalen, 1, (uint64_t)loops * len, t1 - t0);
+}
+
+/**
+ * @brief Update CRC with one block at a time.
+ */
+static void bench_crc32_update(uint32_t len){
+    uint32_t loops = BENCH_BYTES / len + 1;
+    uint32_t state;
+
+    crc32_init(&state);
+    uint64_t t0 = now_ns();
+    for(uint32_t l = 0; l < loops; l++){
+        crc32_update(&state, flash_image, len);
+    }
+    uint64_t t1 = now_ns();
+    sink += state;
+
+    report("crc32_update", len, 0, (uint64_t)loops * len, t1 - t0);
+}
+
+/**
+ * @brief CRC of a full 16KB image, as done by BOOT_GET_CRC32.
+ */
+static void bench_crc32_calc(void){
+    uint32_t loops = BENCH_BYTES / sizeof(flash_image) + 1;
+
+    uint64_t t0 = now_ns();
+    for(uint32_t l = 0; l < loops; l++){
+        sink += crc32_calc(flash_image, sizeof(flash_image));
+    }
+    uint64_t t1 = now_ns();
+
+    report("crc32_calc", sizeof(flash_image), 0, (uint64_t)loops * sizeof(flash_image), t1 - t0);
+}
+
+#ifdef CRC32_ALL_ENGINES
+/**
+ * @brief Every CRC32 engine on the 16KB image, check that they agree.
+ */
+static void bench_crc32_engines(void){
+    static const struct {
+        const char* name;
+        void (*update)(uint32_t *state, const uint8_t *data, size_t len);
+    } engines[] = {
+        {"crc bitwise",     crc32_update_bitwise},
+        {"crc nibble",      crc32_update_nibble},
+        {"crc nibble_unr",  crc32_update_nibble_unrolled},
+        {"crc byte_ram",    crc32_update_byte_ram},
+    };
+    uint32_t loops = BENCH_BYTES / sizeof(flash_image) / 8 + 1;
+    uint32_t expected = crc32_calc(flash_image, sizeof(flash_image));
+
+    for(uint32_t e = 0; e < sizeof(engines) / sizeof(engines[0]); e++){
+        uint32_t state = 0;
+
+        uint64_t t0 = now_ns();
+        for(uint32_t l = 0; l < loops; l++){
+            crc32_init(&state);
+            engines[e].update(&state, flash_image, sizeof(flash_image));
+        }
+        uint64_t t1 = now_ns();
+
+        if(crc32_finalize(&state) != expected){
+            printf("%s does not match crc32_calc\n", engines[e].name);
+            exit(1);
+        }
+
+        report(engines[e].name, sizeof(flash_image), 0, (uint64_t)loops * sizeof(flash_image), t1 - t0);
+    }
+}
+#endif
+
+int main(void){
+#if BOOT_CRC32_ENGINE == CRC32_ENGINE_BYTE_RAM || defined(CRC32_ALL_ENGINES)
+    crc32_table_init();
+#endif
+    fill_payload(flash_image, sizeof(flash_image));
+
+    printf("%-18s %8s %5s %12s %14s\n", "function", "size", "addr", "ns/byte", "bytes/s");
+
+    for(uint32_t s = 0; s < PAYLOAD_SIZES_COUNT; s++){
+        bench_update_rx(payload_sizes[s], 1);
+        bench_update_rx(payload_sizes[s], 8);
+    }
+
+    for(uint32_t s = 0; s < PAYLOAD_SIZES_COUNT; s++){
+        bench_serialize(payload_sizes[s]);
+    }
+
+    //Skip size 0, nothing to measure.
+    for(uint32_t s = 1; s < PAYLOAD_SIZES_COUNT; s++){
+        bench_crc32_update(payload_sizes[s]);
+    }
+
+    bench_crc32_calc();
+
+#ifdef CRC32_ALL_ENGINES
+    bench_crc32_engines();
+#endif
+
+    return 0;
+}
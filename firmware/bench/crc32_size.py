@@ -0,0 +1,86 @@
+#!/usr/bin/env python3
+#
+# Flash and RAM of each CRC32 engine (lib/crc/crc32.c) built for the target.
+#
+# Uses the PlatformIO RISC-V toolchain when found, else --cc:
+#   python bench/crc32_size.py
+#   python bench/crc32_size.py --cc riscv-none-elf-gcc
+#
+# Cycles per byte on the target are printed by test/test_crc32_engines.
+#
+
+import argparse
+import glob
+import os
+import shutil
+import subprocess
+import sys
+import tempfile
+
+ENGINES = ('BITWISE', 'NIBBLE', 'NIBBLE_UNROLLED', 'BYTE_RAM')
+
+# Same as env:dev, without -flto so the object can be measured.
+TARGET_FLAGS = ['-Os', '-march=rv32ec', '-mabi=ilp32e', '-msave-restore',
+                '-ffunction-sections', '-fdata-sections']
+
+HERE = os.path.dirname(os.path.abspath(__file__))
+FIRMWARE = os.path.dirname(HERE)
+
+
+def find_cc():
+    """Compiler from the PlatformIO toolchain package, or PATH."""
+    home = os.environ.get('PLATFORMIO_CORE_DIR', os.path.expanduser('~/.platformio'))
+    for pattern in ('toolchain-riscv*/bin/riscv*-gcc', 'toolchain-riscv*/bin/riscv*-gcc.exe'):
+        found = sorted(glob.glob(os.path.join(home, 'packages', pattern)))
+        if found:
+            return found[0]
+    for name in ('riscv-none-embed-gcc', 'riscv-none-elf-gcc', 'riscv64-unknown-elf-gcc'):
+        if shutil.which(name):
+            return name
+    return None
+
+
+def size_tool(cc):
+    """The binutils size next to the compiler."""
+    base = cc[:-len('.exe')] if cc.endswith('.exe') else cc
+    return base[:-len('gcc')] + 'size' + ('.exe' if cc.endswith('.exe') else '')
+
+
+def measure(cc, cflags, engine, tmp):
+    """Returns (text, data, bss) of crc32.c built with the engine."""
+    obj = os.path.join(tmp, engine.lower() + '.o')
+    cmd = [cc, *cflags, f'-DBOOT_CRC32_ENGINE=CRC32_ENGINE_{engine}',
+           '-I', os.path.join(FIRMWARE, 'include'),
+           '-I', os.path.join(FIRMWARE, 'lib', 'crc'),
+           '-c', os.path.join(FIRMWARE, 'lib', 'crc', 'crc32.c'), '-o', obj]
+    subprocess.run(cmd, check=True)
+
+    # Berkeley format: text data bss dec hex filename
+    out = subprocess.run([size_tool(cc), obj], check=True, capture_output=True, text=True).stdout
+    text, data, bss = out.splitlines()[1].split()[:3]
+    return int(text), int(data), int(bss)
+
+
+def main():
+    parser = argparse.ArgumentParser(description='CRC32 engine size report')
+    parser.add_argument('--cc', help='C compiler (default: PlatformIO RISC-V toolchain)')
+    parser.add_argument('--cflags', help='Replace the target flags, e.g. "-O2" for a host build')
+    args = parser.parse_args()
+
+    cc = args.cc or find_cc()
+    if not cc:
+        print('No RISC-V compiler found, use --cc')
+        return 1
+    cflags = args.cflags.split() if args.cflags is not None else TARGET_FLAGS
+
+    print(f'{cc} {" ".join(cflags)}')
+    print(f'{"engine":<18} {"flash":>6} {"ram":>6}')
+    with tempfile.TemporaryDirectory() as tmp:
+        for engine in ENGINES:
+            text, data, bss = measure(cc, cflags, engine, tmp)
+            print(f'{engine.lower():<18} {text + data:>6} {data + bss:>6}')
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
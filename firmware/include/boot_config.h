@@ -0,0 +1,152 @@
+#ifndef BOOT_CONFIG_H
+#define BOOT_CONFIG_H
+
+//Optional bootloader features.
+//
+//The bootloader must fit in 1920 bytes and the default build only have a few
+//bytes left, so every feature is disabled by default. Enable the features a 
+//product needs in build_flags (platformio.ini), e.g. -DBOOT_FEATURE_SET_BAUD=1,
+//and check the size report.
+//
+//BOOT_INFO reports the enabled features to the host (see BOOT_CAP_xxx in cmd.h).
+
+
+//BOOT_SET_BAUD, switch the bus to a higher baudrate after bus entry.
+#ifndef BOOT_FEATURE_SET_BAUD
+#define BOOT_FEATURE_SET_BAUD       0
+#endif
+
+//Main loop iterations (~4.3us) to wait for a valid packet on the new 
+//baudrate before falling back to 9600 bps.
+#ifndef BOOT_BAUD_CONFIRM_LOOPS
+#define BOOT_BAUD_CONFIRM_LOOPS     (1<<18)
+#endif
+
+//Extended frames with 16bit length, BOOT_WRITE of up to 16 pages (1KB) per packet.
+//Takes ~800 bytes more RAM for the packet buffer.
+#ifndef BOOT_FEATURE_EXT_FRAME
+#define BOOT_FEATURE_EXT_FRAME      0
+#endif
+
+//BOOT_GET_CRC_MAP, CRC32 of up to 16 pages/sectors in one response.
+#ifndef BOOT_FEATURE_CRC_MAP
+#define BOOT_FEATURE_CRC_MAP        0
+#endif
+
+//BOOT_SEARCH_UID, deterministic discovery by UID prefix.
+#ifndef BOOT_FEATURE_UID_SEARCH
+#define BOOT_FEATURE_UID_SEARCH     0
+#endif
+
+//BOOT_ERASE of a block range (1KB sector erase where aligned) and whole application.
+//BOOT_WRITE skips the erase of pages that already are erased.
+#ifndef BOOT_FEATURE_RANGE_ERASE
+#define BOOT_FEATURE_RANGE_ERASE    0
+#endif
+
+//BOOT_WRITE skips pages that already hold the data, BOOT_GET_WRITE_STATS.
+#ifndef BOOT_FEATURE_SKIP_SAME
+#define BOOT_FEATURE_SKIP_SAME      0
+#endif
+
+//BOOT_GET_WRITE_MAP, bitmap of pages written since last reset.
+//Lets the host repeat only the broadcast writes a node missed.
+#ifndef BOOT_FEATURE_WRITE_MAP
+#define BOOT_FEATURE_WRITE_MAP      0
+#endif
+
+//BOOT_GET_STATS, packet/node error counters and busy time.
+#ifndef BOOT_FEATURE_STATS
+#define BOOT_FEATURE_STATS          0
+#endif
+
+//USART RX by DMA into a ring buffer, bytes are not lost while flash is busy.
+#ifndef BOOT_FEATURE_UART_DMA
+#define BOOT_FEATURE_UART_DMA       0
+#endif
+
+//RX ring size, power of 2. 256 bytes is ~22ms at 115200 bps.
+#ifndef BOOT_UART_RING_SIZE
+#define BOOT_UART_RING_SIZE         256
+#endif
+
+//CRC32 implementation used by packets and BOOT_GET_CRC32.
+//Measure flash with bench/crc32_size.py and speed with test_crc32_engines.
+//Not measured on the target yet, the default is the original nibble table.
+#define CRC32_ENGINE_BITWISE            0   //Bit loop.
+#define CRC32_ENGINE_NIBBLE             2   //16 entry table in flash.
+#define CRC32_ENGINE_NIBBLE_UNROLLED    3   //16 entry table, word loads.
+#define CRC32_ENGINE_BYTE_RAM           4   //256 entry table built in RAM (1KB) at startup.
+
+#ifndef BOOT_CRC32_ENGINE
+#define BOOT_CRC32_ENGINE           CRC32_ENGINE_NIBBLE
+#endif
+
+//BOOT_WRITE_PACKED, LZ packed pages decoded into a page buffer (lib/unpack).
+#ifndef BOOT_FEATURE_PACKED_WRITE
+#define BOOT_FEATURE_PACKED_WRITE   0
+#endif
+
+//BOOT_GET_WRITE_CRC, CRC32 per sector accumulated while pages are written.
+//Verify after a write without reading back the flash.
+#ifndef BOOT_FEATURE_WRITE_CRC
+#define BOOT_FEATURE_WRITE_CRC      0
+#endif
+
+//Burst frames, header bit 3 tells that the next frame follows without preamble.
+#ifndef BOOT_FEATURE_BURST
+#define BOOT_FEATURE_BURST          0
+#endif
+
+//BOOT_SLOTTED, broadcast query answered by every node in the slot of its node-id.
+#ifndef BOOT_FEATURE_SLOTTED
+#define BOOT_FEATURE_SLOTTED        0
+#endif
+
+//BOOT_GET_CRC32 with the expected CRC32, only nodes with other flash content answer.
+#ifndef BOOT_FEATURE_QUIET_VERIFY
+#define BOOT_FEATURE_QUIET_VERIFY   0
+#endif
+
+//Application trailer (length, CRC32) at the end of flash. A valid application
+//starts after a short wait for the host, without trailer or with a damaged
+//application after the normal wait.
+#ifndef BOOT_FEATURE_APP_CHECK
+#define BOOT_FEATURE_APP_CHECK      0
+#endif
+
+//Main loop iterations (~4.3us) to wait for a 0x7F sync before a valid
+//application is started, ~70ms.
+#ifndef BOOT_SNIFF_LOOPS
+#define BOOT_SNIFF_LOOPS            (1<<14)
+#endif
+
+//Extended IAP jump table, the application calls the packet parser, serializer
+//and UART helpers of the bootloader (examples/iap_example/iap.h).
+//The exported code runs on the application RAM, so nothing it calls may keep
+//state in bootloader RAM.
+#ifndef BOOT_FEATURE_IAP_PACKET
+#define BOOT_FEATURE_IAP_PACKET     0
+#endif
+
+#if BOOT_FEATURE_IAP_PACKET && (BOOT_FEATURE_UART_DMA || BOOT_FEATURE_STATS \
+    || BOOT_CRC32_ENGINE == CRC32_ENGINE_BYTE_RAM)
+#error "BOOT_FEATURE_IAP_PACKET needs UART, packet and CRC32 without RAM state"
+#endif
+
+//1KB table + 1030 byte packet buffer + 256 byte stack > 2KB RAM.
+#if BOOT_CRC32_ENGINE == CRC32_ENGINE_BYTE_RAM && BOOT_FEATURE_EXT_FRAME
+#error "CRC32_ENGINE_BYTE_RAM does not fit in RAM with BOOT_FEATURE_EXT_FRAME"
+#endif
+
+//Warm entry in the IAP jump table, the application resets into the bootloader
+//with the session active (no sync hold). Requested with a magic word in the
+//last RAM word, top of the stack (Link.ld), read by the startup before RAM init.
+#ifndef BOOT_FEATURE_WARM_ENTRY
+#define BOOT_FEATURE_WARM_ENTRY     0
+#endif
+
+#define BOOT_WARM_ADR               0x200007FC
+#define BOOT_WARM_MAGIC             0xB007B007
+
+#endif
@@ -1,18 +1,66 @@
 #include <stdint.h>
 #include <stddef.h>
+#include "crc32.h"
 
 //CRC32 config
-//The crc32_nibble_table used attribute and assembly instruction
-//is required to get absolute address to the table.
-//Risc-V have something called global pointer.
+//The engine is selected with BOOT_CRC32_ENGINE in boot_config.h, the chosen
+//one is exported as crc32_update. With CRC32_ALL_ENGINES every engine is
+//built under its own name for the test/benchmark harness.
+//
+//Flash and speed on the target are measured by bench/crc32_size.py and
+//test/test_crc32_engines, see README.
 
-//lookup take more flash but is is around 4x faster.
-//Takes around ~72Byte more
-#define USE_CRC_LOOKUP_TABLE 
+#define CRC32_POLY  0xEDB88320uL
 
+//One bit of the reflected CRC, no branch.
+#define CRC32_BIT(crc)  (((crc) >> 1) ^ (CRC32_POLY & (0u - ((crc) & 1))))
+
+#ifdef CRC32_ALL_ENGINES
+#define CRC32_ENGINE_BUILD(e)   1
+#else
+#define CRC32_ENGINE_BUILD(e)   (BOOT_CRC32_ENGINE == (e))
+
+//The selected engine is built as crc32_update.
+#if BOOT_CRC32_ENGINE == CRC32_ENGINE_BITWISE
+#define crc32_update_bitwise            crc32_update
+#elif BOOT_CRC32_ENGINE == CRC32_ENGINE_NIBBLE
+#define crc32_update_nibble             crc32_update
+#elif BOOT_CRC32_ENGINE == CRC32_ENGINE_NIBBLE_UNROLLED
+#define crc32_update_nibble_unrolled    crc32_update
+#elif BOOT_CRC32_ENGINE == CRC32_ENGINE_BYTE_RAM
+#define crc32_update_byte_ram           crc32_update
+#else
+#error "Unknown BOOT_CRC32_ENGINE"
+#endif
+#endif
+
+
+#if CRC32_ENGINE_BUILD(CRC32_ENGINE_BITWISE)
+/**
+ * Update CRC32, one bit at a time.
+ */
+void crc32_update_bitwise(uint32_t *state, const uint8_t *data, size_t len) {
+    uint32_t crc = *state;
+
+    while (len--) {
+        crc ^= *data++;
+        for (uint8_t i = 0; i < 8; i++) {
+            if (crc & 1){
+                 crc = (crc >> 1) ^ CRC32_POLY;
+            }else{
+                crc >>= 1;
+            }
+        }
+    }
+    *state = crc;
+}
+#endif
 
-#ifdef USE_CRC_LOOKUP_TABLE
 
+#if CRC32_ENGINE_BUILD(CRC32_ENGINE_NIBBLE) || CRC32_ENGINE_BUILD(CRC32_ENGINE_NIBBLE_UNROLLED)
+//The crc32_nibble_table used attribute and assembly instruction
+//is required to get absolute address to the table.
+//Risc-V have something called global pointer.
 __attribute__((__used__))
 static const uint32_t crc32_nibble_table[16] = {
     0x00000000, 0x1DB71064, 0x3B6E20C8, 0x26D930AC,
@@ -21,56 +69,142 @@ static const uint32_t crc32_nibble_table[16] = {
     0x9B64C2B0, 0x86D3D2D4, 0xA00AE278, 0xBDBDF21C
 };
 
-
-void crc32_update(uint32_t *state, const uint8_t *data, size_t len) {
-    uint32_t crc = *state;
+/**
+ * Address of the nibble table.
+ */
+static inline const uint32_t* crc32_nibble_ptr(void) {
     const uint32_t *table_ptr;
-    
+
+#ifdef __riscv
     // Uses the Program Counter (PC) to find the table.
     // Done to avoid using GP and Linker Relaxation.
     __asm__ (
         ".option push\n\t"                                      // Store current gcc settings
-        ".option norelax\n\t"                                   // Prevent GP optimization    
+        ".option norelax\n\t"                                   // Prevent GP optimization
         "1: auipc %0, %%pcrel_hi(crc32_nibble_table)\n\t"       // Load address
         "addi %0, %0, %%pcrel_lo(1b)\n\t"                       // ...
         ".option pop"                                           //Restore
         : "=r"(table_ptr));
+#else
+    //Native (host) build, no global pointer to worry about.
+    table_ptr = crc32_nibble_table;
+#endif
+    return table_ptr;
+}
+#endif
+
+
+#if CRC32_ENGINE_BUILD(CRC32_ENGINE_NIBBLE)
+/**
+ * Update CRC32, 16 entry table in flash, two lookups per byte.
+ */
+void crc32_update_nibble(uint32_t *state, const uint8_t *data, size_t len) {
+    uint32_t crc = *state;
+    const uint32_t *table_ptr = crc32_nibble_ptr();
 
     while (len--) {
         uint8_t byte = *data++;
 
         // Process low nibble
         crc = (crc >> 4) ^ table_ptr[(crc ^ (byte >> 0)) & 0x0F];
-        
+
         // Process high nibble
         crc = (crc >> 4) ^ table_ptr[(crc ^ (byte >> 4)) & 0x0F];
     }
     *state = crc;
 }
+#endif
 
-#else
 
+#if CRC32_ENGINE_BUILD(CRC32_ENGINE_NIBBLE_UNROLLED)
 /**
- * Update CRC32
+ * Update CRC32, nibble table with one 32bit load and 8 lookups per aligned word.
  */
-void crc32_update(uint32_t *state, const uint8_t *data, size_t len) {
+void crc32_update_nibble_unrolled(uint32_t *state, const uint8_t *data, size_t len) {
     uint32_t crc = *state;
+    const uint32_t *table_ptr = crc32_nibble_ptr();
+
+    //Bytes until word aligned, then words, then the rest.
+    while (len && ((uintptr_t)data & 3)) {
+        crc ^= *data++;
+        crc = (crc >> 4) ^ table_ptr[crc & 0x0F];
+        crc = (crc >> 4) ^ table_ptr[crc & 0x0F];
+        len--;
+    }
+
+    //Reflected CRC, the Little endian word is xor:ed in one go.
+    while (len >= 4) {
+        crc ^= *(const uint32_t*)data;
+        crc = (crc >> 4) ^ table_ptr[crc & 0x0F];
+        crc = (crc >> 4) ^ table_ptr[crc & 0x0F];
+        crc = (crc >> 4) ^ table_ptr[crc & 0x0F];
+        crc = (crc >> 4) ^ table_ptr[crc & 0x0F];
+        crc = (crc >> 4) ^ table_ptr[crc & 0x0F];
+        crc = (crc >> 4) ^ table_ptr[crc & 0x0F];
+        crc = (crc >> 4) ^ table_ptr[crc & 0x0F];
+        crc = (crc >> 4) ^ table_ptr[crc & 0x0F];
+        data += 4;
+        len -= 4;
+    }
 
     while (len--) {
         crc ^= *data++;
-        for (uint8_t i = 0; i < 8; i++) {
-            if (crc & 1){
-                 crc = (crc >> 1) ^ 0xEDB88320;
-            }else{ 
-                crc >>= 1;
-            }
+        crc = (crc >> 4) ^ table_ptr[crc & 0x0F];
+        crc = (crc >> 4) ^ table_ptr[crc & 0x0F];
+    }
+    *state = crc;
+}
+#endif
+
+
+#if CRC32_ENGINE_BUILD(CRC32_ENGINE_BYTE_RAM)
+//256 entry table, 1KB RAM instead of 1KB flash.
+static uint32_t crc32_byte_table[256];
+
+/**
+ * Build the byte table, once at startup before the first CRC.
+ */
+void crc32_table_init(void) {
+    for (uint32_t i = 0; i < 256; i++) {
+        uint32_t c = i;
+        for (uint8_t b = 0; b < 8; b++) {
+            c = CRC32_BIT(c);
         }
+        crc32_byte_table[i] = c;
+    }
+}
+
+/**
+ * Update CRC32, one lookup per byte. Needs crc32_table_init().
+ */
+void crc32_update_byte_ram(uint32_t *state, const uint8_t *data, size_t len) {
+    uint32_t crc = *state;
+
+    while (len--) {
+        crc = (crc >> 8) ^ crc32_byte_table[(crc ^ *data++) & 0xFF];
     }
     *state = crc;
 }
+#endif
 
 
+#ifdef CRC32_ALL_ENGINES
+/**
+ * Update CRC32 with the selected engine.
+ */
+void crc32_update(uint32_t *state, const uint8_t *data, size_t len) {
+#if BOOT_CRC32_ENGINE == CRC32_ENGINE_BITWISE
+    crc32_update_bitwise(state, data, len);
+#elif BOOT_CRC32_ENGINE == CRC32_ENGINE_NIBBLE_UNROLLED
+    crc32_update_nibble_unrolled(state, data, len);
+#elif BOOT_CRC32_ENGINE == CRC32_ENGINE_BYTE_RAM
+    crc32_update_byte_ram(state, data, len);
+#else
+    crc32_update_nibble(state, data, len);
 #endif
+}
+#endif
+
 
 /**
  * Initialize the CRC value.
@@ -82,7 +216,7 @@ void crc32_init(uint32_t *crc_state) {
 
 
 
-/** 
+/**
  * @calculate a CRC32 value from data.
  */
 uint32_t crc32_calc(const uint8_t *data, size_t len){
@@ -101,4 +235,3 @@ uint32_t crc32_calc(const uint8_t *data, size_t len){
 uint32_t crc32_finalize(uint32_t *crc_state) {
     return *crc_state ^ 0xFFFFFFFF;
 }
-
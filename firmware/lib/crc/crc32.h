@@ -3,6 +3,7 @@
 
 #include <stdint.h>
 #include <stddef.h>
+#include "boot_config.h"
 
 #ifdef __cplusplus
 extern "C" {
@@ -30,6 +31,21 @@ void crc32_update(uint32_t *state, const uint8_t *data, size_t len) ;
  */
 uint32_t crc32_finalize(uint32_t *crc_state);
 
+#if BOOT_CRC32_ENGINE == CRC32_ENGINE_BYTE_RAM || defined(CRC32_ALL_ENGINES)
+/**
+ * @brief Build the RAM table of CRC32_ENGINE_BYTE_RAM, call once at startup.
+ */
+void crc32_table_init(void);
+#endif
+
+#ifdef CRC32_ALL_ENGINES
+//Every engine under its own name, for tests and benchmarks.
+void crc32_update_bitwise(uint32_t *state, const uint8_t *data, size_t len);
+void crc32_update_nibble(uint32_t *state, const uint8_t *data, size_t len);
+void crc32_update_nibble_unrolled(uint32_t *state, const uint8_t *data, size_t len);
+void crc32_update_byte_ram(uint32_t *state, const uint8_t *data, size_t len);
+#endif
+
 #ifdef __cplusplus
 }
 #endif
@@ -123,16 +123,60 @@ void flash_boot_mode_user(void) {
     regs[R_CTLR] |= CR_LOCK_Set; 
 }
 
-void flash_erase(uint32_t adr) {
+void flash_boot_mode_boot(void) {
+    volatile uint32_t* regs = get_flash_regs();
+    flash_unlock(regs);
+
+    regs[R_STATR] |= (1<<14);
+    regs[R_CTLR] |= CR_LOCK_Set;
+}
+
+// Erase operation, mode selects page (64 byte), sector (1KB) or mass erase.
+static void flash_erase_op(uint32_t adr, uint32_t mode) {
     volatile uint32_t* regs = get_flash_regs();
 
     flash_unlock(regs);
 
-    regs[R_CTLR] |= CR_PAGE_ER;
+    regs[R_CTLR] |= mode;
     regs[R_ADDR] = adr;
     regs[R_CTLR] |= CR_STRT_Set;
     while(regs[R_STATR] & SR_BSY){};
-    regs[R_CTLR] &= ~CR_PAGE_ER;
+    regs[R_CTLR] &= ~mode;
+}
+
+void flash_erase(uint32_t adr) {
+    flash_erase_op(adr, CR_PAGE_ER);
+}
+
+void flash_erase_sector(uint32_t adr) {
+    flash_erase_op(adr, CR_PER_Set);
+}
+
+void flash_erase_all(void) {
+    flash_erase_op(0x08000000, CR_MER_Set);
+}
+
+uint32_t flash_is_erased(uint32_t adr) {
+    const uint32_t* p = (const uint32_t*)adr;
+
+    for(int i=0;i<16;i++){
+        if(p[i] != FLASH_ERASED_WORD){
+            return 0;
+        }
+    }
+    return 1;
+}
+
+uint32_t flash_is_equal(uint32_t adr, const uint8_t data[64]) {
+    const uint32_t* p = (const uint32_t*)adr;
+    const uint32_t* d = (const uint32_t*)data;
+
+    for(int i=0;i<16;i++){
+        if(p[i] != d[i]){
+            return 0;
+        }
+    }
+    return 1;
 }
 
 void flash_write(uint32_t adr, uint8_t data[64]) {
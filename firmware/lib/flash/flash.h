@@ -4,11 +4,19 @@
 #include <stdint.h>
 #include <stddef.h>
 
-//Set flash boot mode.
+//Set flash boot mode, used by the next software reset.
 void flash_boot_mode_user(void);
+void flash_boot_mode_boot(void);
+
+//Erased flash does not read as 0xFF on CH32V003.
+#define FLASH_ERASED_WORD   0xE339E339
 
 //Flase erase and write function.
 void flash_erase(uint32_t adr);
+void flash_erase_sector(uint32_t adr);
+void flash_erase_all(void);
+uint32_t flash_is_erased(uint32_t adr);
+uint32_t flash_is_equal(uint32_t adr, const uint8_t data[64]);
 void flash_write(uint32_t adr, uint8_t data[64]);
 void flash_write_option_data(uint8_t data0, uint8_t data1);
 
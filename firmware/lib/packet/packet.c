@@ -3,13 +3,23 @@
 
 
 typedef enum { 
-    STATE_IDLE, STATE_HDR, STATE_ADDR, STATE_CMD, STATE_LEN, STATE_DATA, STATE_CRC 
+    STATE_IDLE, STATE_HDR, STATE_ADDR, STATE_CMD, STATE_LEN, STATE_LEN_HI, STATE_DATA, STATE_CRC,
+    STATE_NEXT
 } RxState_t;
 
 
-#define HDR_MASK_BASE       0x80 // Top 6 bits are 100000
-#define HDR_FLAG_ADR_128BIT 0x02 // Bit 1
-#define HDR_MASK_TYPE       0x01 // Bit 0
+//Header bits that must be 0, optional flags only when supported.
+#if BOOT_FEATURE_EXT_FRAME
+#define HDR_MASK_EXT        0
+#else
+#define HDR_MASK_EXT        HDR_FLAG_EXT_LEN
+#endif
+#if BOOT_FEATURE_BURST
+#define HDR_MASK_BURST      0
+#else
+#define HDR_MASK_BURST      HDR_FLAG_BURST
+#endif
+#define HDR_MASK_CHECK      (0xF0 | HDR_MASK_BURST | HDR_MASK_EXT)
 
 
 /**
@@ -50,91 +60,129 @@ uint32_t packet_serialize(uint8_t* buffer,
     return i;
 }
 
-volatile uint32_t total_sync_count=0;
-
-uint32_t get_packet_total_sync_count(void){
-    return total_sync_count;
-}
+#if BOOT_FEATURE_STATS
+PacketStats_t packet_stats;
+#define STATS_INC(x)    (packet_stats.x++)
+#else
+#define STATS_INC(x)
+#endif
 
 uint8_t Packet_Update_Rx(uint8_t byte, Packet_t *pkt) {
-    static RxState_t state = STATE_IDLE;
-    static uint8_t sync_count = 0;
-    static uint8_t index ;
-    static uint8_t crc_buf[4];
-    static uint32_t crc_state;
+    PacketRx_t* rx = &pkt->rx;
 
     // --- Resync Logic ---
     // Always active to detect resync.
     if (byte == PREAMBLE_BYTE) {
-        sync_count++;
-        total_sync_count++;
+        rx->sync_count++;
+        rx->sync_total++;
     } else {
-        if (sync_count >= PREAMBLE_COUNT){
+        if (rx->sync_count >= PREAMBLE_COUNT){
             //Check if we got valid HDR.
-            if((byte & 0xFC) == HDR_MASK_BASE) {
-                state = STATE_HDR;
+            if((byte & HDR_MASK_CHECK) == HDR_MASK_BASE) {
+                rx->state = STATE_HDR;
             }
         }
         
         //Reset sync counter.
-        sync_count = 0;
+        rx->sync_count = 0;
+    }
+
+#if BOOT_FEATURE_BURST
+    //Next frame of a burst starts directly with the header, anything else
+    //(preamble included) waits for a new preamble.
+    if(rx->state == STATE_NEXT){
+        rx->state = ((byte & HDR_MASK_CHECK) == HDR_MASK_BASE) ? STATE_HDR : STATE_IDLE;
     }
+#endif
 
     //Skip rest code if we are in idle state.
-    if(state == STATE_IDLE)
+    if(rx->state == STATE_IDLE)
     {
         return 0;
     }
 
     
     //state machine.
-    if(state == STATE_HDR){
-        crc32_init(&crc_state);
+    if(rx->state == STATE_HDR){
+        crc32_init(&rx->crc_state);
 
         // Decode attributes using bit 0-1 for type
-        pkt->type = (PacketType_t)(byte & HDR_MASK_TYPE);
+        pkt->type = byte & HDR_MASK_TYPE;
         pkt->addr_len = (byte & HDR_FLAG_ADR_128BIT) ? 8 : 1;
-
-        index = 0;
-        state = STATE_ADDR;
-    }else if(state == STATE_ADDR){
-        pkt->address[index++] = byte;
+#if BOOT_FEATURE_EXT_FRAME
+        rx->ext_len = byte & HDR_FLAG_EXT_LEN;
+#endif
+#if BOOT_FEATURE_BURST
+        rx->burst = byte & HDR_FLAG_BURST;
+#endif
+
+        rx->index = 0;
+        rx->state = STATE_ADDR;
+    }else if(rx->state == STATE_ADDR){
+        pkt->address[rx->index++] = byte;
         
-        if (index == pkt->addr_len){
-            state = STATE_CMD;
+        if (rx->index == pkt->addr_len){
+            rx->state = STATE_CMD;
         } 
-    }else if(state == STATE_CMD){
+    }else if(rx->state == STATE_CMD){
         pkt->command = byte;
-        state = STATE_LEN;
-    }else if(state == STATE_LEN){
+        rx->state = STATE_LEN;
+    }else if(rx->state == STATE_LEN){
         pkt->data_len = byte;
-        index = 0;
-        state = (pkt->data_len > 0) ? STATE_DATA : STATE_CRC;
-    }else if(state == STATE_DATA){
-        pkt->data[index++] = byte;
-        if (index == pkt->data_len){
-            index=0;
-            state = STATE_CRC;
+        rx->index = 0;
+        rx->state = (pkt->data_len > 0) ? STATE_DATA : STATE_CRC;
+#if BOOT_FEATURE_EXT_FRAME
+        if(rx->ext_len){
+            rx->state = STATE_LEN_HI;
+        }
+    }else if(rx->state == STATE_LEN_HI){
+        pkt->data_len |= (packet_len_t)byte << 8;
+        rx->state = (pkt->data_len > 0) ? STATE_DATA : STATE_CRC;
+
+        //Does not fit in buffer, wait for next preamble.
+        if(pkt->data_len > PACKET_DATA_MAX){
+            STATS_INC(too_long);
+            rx->state = STATE_IDLE;
+            return 0;
+        }
+#endif
+    }else if(rx->state == STATE_DATA){
+        pkt->data[rx->index++] = byte;
+        if (rx->index == pkt->data_len){
+            rx->index=0;
+            rx->state = STATE_CRC;
         } 
-    }else if(state == STATE_CRC){
-        crc_buf[index++] = byte;
+    }else if(rx->state == STATE_CRC){
+        rx->crc_buf[rx->index++] = byte;
 
-        if (index == 4) 
+        if (rx->index == 4) 
         {
-            uint32_t crc_rx = *(uint32_t*)&crc_buf[0];  
+            uint32_t crc_rx = *(uint32_t*)&rx->crc_buf[0];  
 
             //get the calculated CRC32. 
-            uint32_t crc_calc = crc32_finalize(&crc_state);
+            uint32_t crc_calc = crc32_finalize(&rx->crc_state);
             
             //Restore state machine.
-            state = STATE_IDLE;
-            sync_count = 0;
+            rx->state = STATE_IDLE;
+            rx->sync_count = 0;
 
             //only process packages that are request type.
             if(pkt->type == PKT_TYPE_REQUEST){
                 //Check for CRC32 match
-                return (crc_rx == crc_calc);
+                if(crc_rx != crc_calc){
+                    STATS_INC(crc_errors);
+                    return 0;
+                }
+                STATS_INC(rx_ok);
+#if BOOT_FEATURE_BURST
+                //A lost frame breaks the burst, only a valid one continue it.
+                if(rx->burst){
+                    rx->state = STATE_NEXT;
+                }
+#endif
+                return 1;
             }else{
+                STATS_INC(wrong_type);
                 return 0;
             }
 
@@ -145,7 +193,7 @@ uint8_t Packet_Update_Rx(uint8_t byte, Packet_t *pkt) {
     }
 
     //Update the CRC
-    crc32_update(&crc_state, &byte, 1);
+    crc32_update(&rx->crc_state, &byte, 1);
     return 0;
 }
 
@@ -3,26 +3,71 @@
 
 #include <stdint.h>
 #include <stddef.h>
+#include "boot_config.h"
 
 #define PREAMBLE_BYTE  0x7F
 #define PREAMBLE_COUNT 5
 
+//Frame header byte.
+#define HDR_MASK_BASE       0x80 // Top 6 bits are 100000
+#define HDR_FLAG_BURST      0x08 // Bit 3, next frame without preamble (BOOT_FEATURE_BURST)
+#define HDR_FLAG_EXT_LEN    0x04 // Bit 2, 16bit length (BOOT_FEATURE_EXT_FRAME)
+#define HDR_FLAG_ADR_128BIT 0x02 // Bit 1
+#define HDR_MASK_TYPE       0x01 // Bit 0
+
+#if BOOT_FEATURE_EXT_FRAME
+//BOOT_WRITE header (6) + 16 pages.
+#define PACKET_DATA_MAX 1030
+typedef uint16_t packet_len_t;
+#else
+#define PACKET_DATA_MAX 255
+typedef uint8_t packet_len_t;
+#endif
+
 typedef enum {
     PKT_TYPE_REQUEST  = 0x00,
     PKT_TYPE_RESPONSE = 0x01
 } PacketType_t;
 
+//Receive state of Packet_Update_Rx, kept in the packet instead of static data
+//so the application can run its own parser through the IAP table.
+//Same layout for all features, zero is idle.
 typedef struct {
-    PacketType_t type;
+    uint8_t state;
+    uint8_t sync_count;
+    uint8_t ext_len;
+    uint8_t burst;
+    uint16_t index;
+    uint8_t crc_buf[4] __attribute__((aligned(4)));
+    uint32_t crc_state;
+    uint32_t sync_total;    //Preamble bytes since start.
+} PacketRx_t;
+
+typedef struct {
+    PacketRx_t rx;
+
+    uint8_t type;           //PacketType_t
     uint8_t command;
 
     uint8_t address[8] __attribute__((aligned(4)));;
     uint8_t addr_len;
     
-    uint8_t data_len;
-    uint8_t data[255] __attribute__((aligned(4)));;
+    packet_len_t data_len;
+    uint8_t data[PACKET_DATA_MAX] __attribute__((aligned(4)));;
 } Packet_t;
 
+#if BOOT_FEATURE_STATS
+//Receive counters, reported by BOOT_GET_STATS.
+typedef struct {
+    uint16_t rx_ok;         //Valid request frames.
+    uint16_t crc_errors;    //Request frames with CRC mismatch.
+    uint16_t wrong_type;    //Response frames from other nodes.
+    uint16_t too_long;      //Frames longer than the packet buffer.
+} PacketStats_t;
+
+extern PacketStats_t packet_stats;
+#endif
+
 /**
  * @brief Serializes a RESPONSE packet .
  * @note Only 8bit addressing supported.
@@ -39,13 +84,10 @@ uint32_t packet_serialize(uint8_t* buffer,
 
 /**
  * @brief Handles a single incoming byte (supports both Request and Response).
+ * @note  With BOOT_FEATURE_EXT_FRAME the length field is 16bit when header bit 2 is set.
+ * @note  All state is in pkt, start with a zeroed packet.
  * @return 1 if a full valid packet was completed (CRC matches), 0 otherwise.
  */
 uint8_t Packet_Update_Rx(uint8_t byte, Packet_t *pkt);
 
-/**
- * @brief Get total number of sync chars found
- */
-uint32_t get_packet_total_sync_count(void);
-
 #endif
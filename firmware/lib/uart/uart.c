@@ -1,6 +1,15 @@
 #include "uart.h"
 #include <ch32v00x.h>
 
+#if BOOT_FEATURE_STATS
+uint16_t uart_overruns;
+#endif
+
+#if BOOT_FEATURE_STATS && !BOOT_FEATURE_UART_DMA
+//Own echo on the half-duplex line not yet read, its overrun is not counted.
+static uint8_t rx_echo;
+#endif
+
 /**
  * @brief Write outgoing data
  */
@@ -9,13 +18,64 @@ void uart_write(uint8_t ch){
     //may use USART_FLAG_TC instead?.
     while((USART1->STATR & USART_FLAG_TXE) == (uint16_t)RESET);
     USART1->DATAR = ch;
+#if BOOT_FEATURE_STATS && !BOOT_FEATURE_UART_DMA
+    rx_echo = 1;
+#endif
 }
 
+#if BOOT_FEATURE_UART_DMA
+#define RING_MASK   (BOOT_UART_RING_SIZE - 1)
+
+//Filled by DMA1 channel 5 (USART1_RX) in circular mode, no interrupt needed.
+static uint8_t rx_ring[BOOT_UART_RING_SIZE];
+static uint32_t rx_tail;
+
+/**
+ * @brief check if we got incomming data
+ */
+uint32_t uart_available(void){
+    uint32_t head = (BOOT_UART_RING_SIZE - DMA1_Channel5->CNTR) & RING_MASK;
+
+#if BOOT_FEATURE_STATS
+    //DMA wrapped and passed the unread data. Approximate, seen only when
+    //the ring has wrapped past rx_tail at this poll, several laps count once.
+    if(DMA1->INTFR & DMA1_FLAG_TC5){
+        DMA1->INTFCR = DMA1_FLAG_TC5;
+        if(head > rx_tail){
+            uart_overruns++;
+        }
+    }
+#endif
+    return head != rx_tail;
+}
+
+/**
+ * @brief Read incomming data
+ */
+uint8_t uart_read(void){
+    uint8_t ch = rx_ring[rx_tail];
+    rx_tail = (rx_tail + 1) & RING_MASK;
+    return ch;
+}
+#else
 /**
  * @brief check if we got incomming data
  */
 uint32_t uart_available(void){
-    return (USART1->STATR & USART_FLAG_RXNE) != (uint16_t)RESET;
+    uint16_t statr = USART1->STATR;
+
+#if BOOT_FEATURE_STATS
+    //Cleared by the following read of DATAR. Only while receiving, the echo
+    //of a reply is not read while it is sent.
+    if((statr & USART_FLAG_ORE) && !rx_echo){
+        uart_overruns++;
+    }
+    //Echo drained.
+    if(!(statr & USART_FLAG_RXNE)){
+        rx_echo = 0;
+    }
+#endif
+    return (statr & USART_FLAG_RXNE) != (uint16_t)RESET;
 }
 
 /**
@@ -24,6 +84,7 @@ uint32_t uart_available(void){
 uint8_t uart_read(void){
     return (uint8_t)USART1->DATAR;
 }
+#endif
 
 
 /**
@@ -34,13 +95,42 @@ void uart_init(void){
     // 9600 bps @ 8Mhz
     // Half-duplex
     // Eanabled with Tx and RX 
-    USART1->BRR = 833;
+    USART1->BRR = UART_BRR_DEFAULT;
+#if BOOT_FEATURE_UART_DMA
+    //RX by DMA, peripheral to memory, 8bit, circular.
+    RCC->AHBPCENR |= RCC_DMA1EN;
+    DMA1_Channel5->PADDR = (uint32_t)&USART1->DATAR;
+    DMA1_Channel5->MADDR = (uint32_t)&rx_ring[0];
+    DMA1_Channel5->CNTR = BOOT_UART_RING_SIZE;
+    DMA1_Channel5->CFGR = DMA_CFGR1_MINC | DMA_CFGR1_CIRC | DMA_CFGR1_EN;
+    USART1->CTLR3 = USART_CTLR3_HDSEL | USART_CTLR3_DMAR;
+#else
     USART1->CTLR3 = USART_CTLR3_HDSEL; 
+#endif
     USART1->CTLR1 = USART_CTLR1_UE | USART_CTLR1_TE | USART_CTLR1_RE;
 }
 
+/**
+ * @brief Change baudrate, BRR = 8Mhz / baudrate.
+ */
+void uart_set_brr(uint16_t brr){
+    USART1->BRR = brr;
+}
+
+/**
+ * @brief Get current baudrate setting.
+ */
+uint16_t uart_get_brr(void){
+    return USART1->BRR;
+}
+
 void uart_deinit(void){
     //Disable Uart.
     USART1->CTLR1 = 0;
     USART1->CTLR3 = 0; 
+
+#if BOOT_FEATURE_UART_DMA
+    DMA1_Channel5->CFGR = 0;
+    RCC->AHBPCENR &= ~RCC_DMA1EN;
+#endif
 }
@@ -2,14 +2,37 @@
 #define _UART_H
 
 #include "stdint.h"
+#include "boot_config.h"
+
+//9600 bps @ 8Mhz
+#define UART_BRR_DEFAULT    833
+//500000 bps @ 8Mhz, USARTDIV below 1 is not a valid setting.
+#define UART_BRR_MIN        16
 
 void uart_init(void);
 void uart_deinit(void);
+void uart_set_brr(uint16_t brr);
+uint16_t uart_get_brr(void);
 
 void uart_write(uint8_t ch);
 uint32_t uart_available(void);
 uint8_t uart_read(void);
 
+#if BOOT_FEATURE_STATS
+//Bytes lost because the previous was not read in time.
+extern uint16_t uart_overruns;
+#endif
+
+//Busy wait, ~1us per loop @ 8Mhz.
+//The host simulator (BOOT_SIM) replace it with a real sleep.
+#ifndef BOOT_SIM
+static inline void uart_delay(uint32_t loops){
+    volatile uint32_t delay = loops;
+    while(delay--){}
+}
+#else
+void uart_delay(uint32_t loops);
+#endif
 
 
 #endif
\ No newline at end of file
@@ -0,0 +1,62 @@
+#include <stdint.h>
+#include <stddef.h>
+#include "unpack.h"
+
+uint32_t unpack_pages(const uint8_t* src, size_t len, uint32_t adr, uint8_t* page, unpack_emit_t emit){
+    const uint8_t* end = src + len;
+    uint32_t out = 0;
+
+    while(src < end){
+        uint32_t token = *src++;
+        uint32_t count;
+        uint32_t dist = 0;
+
+        if(token < 0x80){
+            count = token + 1;
+            if(count > (uint32_t)(end - src)){
+                return 0;
+            }
+        }else{
+            //Distance bytes must be in the stream.
+            if((uint32_t)(end - src) < ((token & 0x40) ? 2u : 1u)){
+                return 0;
+            }
+            count = (token & 0x3F) + 3;
+            dist = *src++;
+            if(token & 0x40){
+                dist |= (uint32_t)(*src++) << 8;
+            }
+            dist++;
+
+            //Only data from this stream.
+            if(dist > out){
+                return 0;
+            }
+        }
+
+        while(count--){
+            uint8_t b;
+
+            if(dist == 0){
+                b = *src++;
+            }else{
+                //Current page is in the buffer, earlier pages are programmed.
+                uint32_t from = out - dist;
+                if(from >= (out & ~63u)){
+                    b = page[from & 63];
+                }else{
+                    b = *(const uint8_t*)(adr + from);
+                }
+            }
+
+            page[out & 63] = b;
+            out++;
+
+            if((out & 63) == 0){
+                emit(adr + out - 64, page);
+            }
+        }
+    }
+
+    return out;
+}
@@ -0,0 +1,42 @@
+#ifndef UNPACK_H
+#define UNPACK_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+//
+//Packed page stream, decoded one 64 byte page at a time.
+//
+//  0x00..0x7F  Literal, (token + 1) bytes follow.
+//  0x80..0xBF  Match, length (token & 0x3F) + 3, one distance byte.
+//  0xC0..0xFF  Match, length (token & 0x3F) + 3, two distance bytes (Little endian).
+//
+//Distance is stored minus one and may reach back into pages already emitted
+//by the same stream, they are read back from the output address.
+//
+
+/**
+ * @brief Called for every completed page.
+ */
+typedef void (*unpack_emit_t)(uint32_t adr, uint8_t* page);
+
+/**
+ * @brief Decode a packed stream into pages starting at adr.
+ * @param src   Packed stream.
+ * @param len   Length of the packed stream.
+ * @param adr   Address of the first page, earlier pages are read back from here.
+ * @param page  64 byte page buffer passed to emit.
+ * @param emit  Called with each full page, a trailing partial page is dropped.
+ * @return Decoded bytes, 0 if the stream is malformed.
+ */
+uint32_t unpack_pages(const uint8_t* src, size_t len, uint32_t adr, uint8_t* page, unpack_emit_t emit);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // UNPACK_H
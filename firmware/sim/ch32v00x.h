@@ -0,0 +1,67 @@
+#ifndef SIM_CH32V00X_H
+#define SIM_CH32V00X_H
+
+//
+//Host replacement of the CH32V003 device header for the simulator.
+//Only what main.c use, the registers are plain memory.
+//
+
+#include <stdint.h>
+
+typedef struct {
+    volatile uint32_t CTLR;
+    volatile uint32_t CFGR0;
+    volatile uint32_t INTR;
+    volatile uint32_t APB2PRSTR;
+    volatile uint32_t APB1PRSTR;
+    volatile uint32_t AHBPCENR;
+    volatile uint32_t APB2PCENR;
+    volatile uint32_t APB1PCENR;
+    volatile uint32_t RSTSCKR;
+} RCC_TypeDef;
+
+typedef struct {
+    volatile uint32_t ECR;
+    volatile uint32_t PCFR1;
+    volatile uint32_t EXTICR;
+} AFIO_TypeDef;
+
+typedef struct {
+    volatile uint32_t CFGLR;
+    volatile uint32_t CFGHR;
+    volatile uint32_t INDR;
+    volatile uint32_t OUTDR;
+    volatile uint32_t BSHR;
+    volatile uint32_t BCR;
+    volatile uint32_t LCKR;
+} GPIO_TypeDef;
+
+typedef struct {
+    volatile uint32_t CTLR;
+    volatile uint32_t SR;
+    volatile uint32_t CNT;
+    uint32_t RESERVED0;
+    volatile uint32_t CMP;
+} SysTick_Type;
+
+extern RCC_TypeDef sim_rcc;
+extern AFIO_TypeDef sim_afio;
+extern GPIO_TypeDef sim_gpiod;
+
+#define RCC                 (&sim_rcc)
+#define AFIO                (&sim_afio)
+#define GPIOD               (&sim_gpiod)
+
+//SysTick counting 1us from the host clock.
+SysTick_Type* sim_systick(void);
+#define SysTick             (sim_systick())
+
+#define RCC_HPRE_DIV3       ((uint32_t)0x00000090)
+#define RCC_AFIOEN          ((uint32_t)0x00000001)
+#define RCC_IOPDEN          ((uint32_t)0x00000020)
+#define RCC_USART1EN        ((uint32_t)0x00004000)
+
+void RCC_ClearFlag(void);
+void NVIC_SystemReset(void);
+
+#endif
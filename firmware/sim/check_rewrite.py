@@ -0,0 +1,57 @@
+#!/usr/bin/env python3
+"""
+Sim check, writing the same image twice programs no page the second time.
+
+Needs a sim built with BOOT_FEATURE_SKIP_SAME (and BOOT_FEATURE_RANGE_ERASE
+to check that the range erase does not defeat the page compare).
+
+    python sim/check_rewrite.py .pio/build/sim/program ../uploader/fw_blink_pa2.bin
+"""
+
+import os
+import re
+import signal
+import subprocess
+import sys
+import tempfile
+import time
+
+UPLOADER = os.path.join(os.path.dirname(os.path.abspath(__file__)), '..', '..', 'uploader', 'uploader.py')
+NODES = 4
+
+
+def write(link, image):
+    cmd = [sys.executable, UPLOADER, '--port', link, '--fw', '0', '-i', image, '--detect', '--write']
+    return subprocess.run(cmd, capture_output=True, text=True, timeout=600).stdout
+
+
+def main():
+    if len(sys.argv) != 3:
+        print(__doc__)
+        return 2
+    sim, image = sys.argv[1], sys.argv[2]
+    link = os.path.join(tempfile.mkdtemp(), 'ttyBUS')
+
+    hub = subprocess.Popen([sim, '-n', str(NODES), '-l', link],
+                           stdout=subprocess.DEVNULL, stderr=subprocess.DEVNULL)
+    try:
+        while not os.path.exists(link):
+            time.sleep(0.1)
+
+        write(link, image)
+        out = write(link, image)
+    finally:
+        hub.send_signal(signal.SIGINT)
+        hub.wait()
+
+    stats = re.findall(r'(\d+) pages written, (\d+) identical pages skipped', out)
+    if len(stats) != NODES or any(int(written) for written, _ in stats):
+        print(out)
+        print(f"FAIL: identical rewrite, {stats}")
+        return 1
+    print(f"OK: identical rewrite, {NODES} nodes skipped {stats[0][1]} pages")
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
@@ -0,0 +1,81 @@
+#!/usr/bin/env python3
+"""
+Sim check, every node answers a BOOT_SLOTTED query in the slot of its node-id.
+
+Needs a sim built with BOOT_FEATURE_SLOTTED and BOOT_FEATURE_UID_SEARCH. The
+sim gives the nodes the node-ids 1..N, a reply missing from the slotted query
+would make the uploader ask that node one by one.
+
+    python sim/check_slotted.py .pio/build/sim/program
+"""
+
+import os
+import signal
+import struct
+import subprocess
+import sys
+import tempfile
+import time
+
+sys.path.insert(0, os.path.join(os.path.dirname(os.path.abspath(__file__)), '..', '..', 'uploader'))
+from uploader import (CH32V003Bootloader, BOOT_CAP_SLOTTED, BOOT_GET_CRC, BOOT_GET_INFO,
+                      CRC_TIME_PER_BYTE)
+
+NODES = 8
+ROUNDS = 5
+CRC_LENGTH = 1024
+
+
+def check(loader, targets):
+    """UIDs missing from a slotted query, without and with node work before the slot."""
+    queries = [
+        (BOOT_GET_INFO, b'', 6, 0.0),
+        (BOOT_GET_CRC, struct.pack('<II', 0x08000000, CRC_LENGTH), 4, CRC_LENGTH * CRC_TIME_PER_BYTE),
+    ]
+    missing = []
+    for cmd, data, length, work in queries:
+        for _ in range(ROUNDS):
+            replies = loader.slotted_query(cmd, data, length, targets, work)
+            missing += [(cmd, uid) for uid in targets if uid not in replies]
+            loader._settle()
+    return missing
+
+
+def main():
+    if len(sys.argv) != 2:
+        print(__doc__)
+        return 2
+    sim = sys.argv[1]
+    link = os.path.join(tempfile.mkdtemp(), 'ttyBUS')
+
+    hub = subprocess.Popen([sim, '-n', str(NODES), '-l', link],
+                           stdout=subprocess.DEVNULL, stderr=subprocess.DEVNULL)
+    try:
+        while not os.path.exists(link):
+            time.sleep(0.1)
+
+        loader = CH32V003Bootloader(link)
+        try:
+            loader.enter_bootloader()
+            targets = loader.find_targets(0)
+            if len(targets) != NODES or not all(inf['caps'] & BOOT_CAP_SLOTTED for inf in targets.values()):
+                print(f"FAIL: found {len(targets)} of {NODES} nodes, all need BOOT_CAP_SLOTTED")
+                return 1
+            missing = check(loader, targets)
+        finally:
+            loader.close()
+    finally:
+        hub.send_signal(signal.SIGINT)
+        hub.wait()
+
+    if missing:
+        for cmd, uid in missing:
+            print(f"0x{cmd:02X}: no reply from {uid} (node-id {targets[uid]['node_id']})")
+        print(f"FAIL: slotted query, {len(missing)} missing replies")
+        return 1
+    print(f"OK: slotted query, {NODES} nodes answered {2 * ROUNDS} queries in their slots")
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
@@ -0,0 +1,42 @@
+#ifndef ISS_H
+#define ISS_H
+
+#include <stdint.h>
+#include "rv32.h"
+#include "sim.h"
+
+//
+//Node of the instruction simulator, shared by iss_node.c and iss_mem.c.
+//
+
+//Bootloader area at the start of the system flash (Link.ld), aliased at 0.
+#define ISS_BOOT_SIZE       1920u
+
+#define ISS_RAM_BASE        0x20000000u
+#define ISS_RAM_SIZE        0x800u
+
+//Node memory from the hub memory file.
+extern uint8_t* iss_flash;
+extern uint8_t* iss_system;
+
+extern Rv32_t iss_cpu;
+
+//Picoseconds per CPU cycle, follows the RCC clock setup.
+extern uint32_t iss_ps_per_cycle;
+
+//Cycle of the next peripheral event, iss_mem_event() is called when reached.
+extern uint64_t iss_next_event;
+
+//Exit code requested by a system reset, 0 while running.
+extern int iss_reset;
+
+void iss_mem_reset(void);
+void iss_mem_event(void);
+
+//Byte from the bus to USART1.
+void iss_uart_rx(const SimBusByte_t* msg);
+
+//Byte from USART1 to the bus (iss_node.c).
+void iss_bus_send(uint8_t byte, uint16_t brr);
+
+#endif
@@ -0,0 +1,672 @@
+//
+//Memory map and peripheral models of an instruction simulator node.
+//
+//Same addresses as the CH32V003 booting from the system flash:
+//  0x00000000  alias of the system flash (bootloader)
+//  0x08000000  application flash, FLASH controller programs it
+//  0x1FFFF000  system flash, bootloader, UID and option bytes
+//  0x20000000  2KB SRAM
+//  0x40000000  peripherals, USART1, DMA1, FLASH and RCC are modeled,
+//              the others are plain registers
+//  0xE000E000  PFIC (system reset) and SysTick
+//
+
+#include <string.h>
+#include "iss.h"
+
+//FLASH_ERASED_WORD of lib/flash.
+#define ERASED_WORD         0xE339E339u
+
+#define PERIPH_BASE         0x40000000u
+#define PERIPH_SIZE         0x30000u
+#define CORE_BASE           0xE000E000u
+#define CORE_SIZE           0x2000u
+
+#define USART1_BASE         0x40013800u
+#define DMA1_BASE           0x40020000u
+#define RCC_BASE            0x40021000u
+#define FLASH_BASE          0x40022000u
+#define PFIC_BASE           0xE000E000u
+#define SYSTICK_BASE        0xE000F000u
+
+//USART1 registers and bits.
+#define USART_STATR         (USART1_BASE + 0x00)
+#define USART_DATAR         (USART1_BASE + 0x04)
+#define USART_BRR           (USART1_BASE + 0x08)
+#define USART_CTLR1         (USART1_BASE + 0x0C)
+#define USART_CTLR3         (USART1_BASE + 0x14)
+#define USART_FE            (1u << 1)
+#define USART_ORE           (1u << 3)
+#define USART_RXNE          (1u << 5)
+#define USART_TC            (1u << 6)
+#define USART_TXE           (1u << 7)
+#define USART_RE            (1u << 2)
+#define USART_TE            (1u << 3)
+#define USART_UE            (1u << 13)
+#define USART_DMAR          (1u << 6)
+
+//DMA1 registers, channel 5 is USART1_RX.
+#define DMA_INTFR           (DMA1_BASE + 0x00)
+#define DMA_INTFCR          (DMA1_BASE + 0x04)
+#define DMA_CH5_CFGR        (DMA1_BASE + 0x58)
+#define DMA_CH5_CNTR        (DMA1_BASE + 0x5C)
+#define DMA_CH5_MADDR       (DMA1_BASE + 0x64)
+#define DMA_EN              (1u << 0)
+#define DMA_CIRC            (1u << 5)
+#define DMA_MINC            (1u << 7)
+#define DMA_GIF5            (1u << 16)
+#define DMA_TCIF5           (1u << 17)
+#define DMA_HTIF5           (1u << 18)
+
+//RCC, HSI 24MHz and the PLL (x2).
+#define RCC_CFGR0           (RCC_BASE + 0x04)
+#define HSI_HZ              24000000u
+
+//FLASH controller registers and bits.
+#define FLASH_KEYR          (FLASH_BASE + 0x04)
+#define FLASH_OBKEYR        (FLASH_BASE + 0x08)
+#define FLASH_STATR         (FLASH_BASE + 0x0C)
+#define FLASH_CTLR          (FLASH_BASE + 0x10)
+#define FLASH_ADDR          (FLASH_BASE + 0x14)
+#define FLASH_MODEKEYR      (FLASH_BASE + 0x24)
+#define FLASH_KEY1          0x45670123u
+#define FLASH_KEY2          0xCDEF89ABu
+#define SR_BSY              (1u << 0)
+#define SR_WRPRTERR         (1u << 4)
+#define SR_EOP              (1u << 5)
+#define SR_MODE             (1u << 14)
+#define CR_PG               (1u << 0)
+#define CR_PER              (1u << 1)
+#define CR_MER              (1u << 2)
+#define CR_OPTPG            (1u << 4)
+#define CR_OPTER            (1u << 5)
+#define CR_STRT             (1u << 6)
+#define CR_LOCK             (1u << 7)
+#define CR_OBWRE            (1u << 9)
+#define CR_FLOCK            (1u << 15)
+#define CR_PAGE_PG          (1u << 16)
+#define CR_PAGE_ER          (1u << 17)
+#define CR_BUF_LOAD         (1u << 18)
+#define CR_BUF_RST          (1u << 19)
+
+//PFIC system reset, key in the upper half.
+#define PFIC_CFGR           (PFIC_BASE + 0x48)
+#define PFIC_KEY3           0xBEEFu
+#define PFIC_RESETSYS       (1u << 7)
+
+//SysTick, counts HCLK or HCLK/8.
+#define SYSTICK_CTLR        (SYSTICK_BASE + 0x00)
+#define SYSTICK_CNT         (SYSTICK_BASE + 0x08)
+#define SYSTICK_STE         (1u << 0)
+#define SYSTICK_STCLK       (1u << 2)
+
+#define OPTION_SIZE         0x40u
+
+uint8_t* iss_flash;
+uint8_t* iss_system;
+Rv32_t iss_cpu;
+uint32_t iss_ps_per_cycle;
+uint64_t iss_next_event;
+int iss_reset;
+
+static uint8_t ram[ISS_RAM_SIZE];
+
+//Plain registers, also the stored value of the modeled ones.
+static uint32_t periph[PERIPH_SIZE / 4];
+static uint32_t core[CORE_SIZE / 4];
+
+static uint32_t hclk;
+
+static struct {
+    uint32_t statr;
+    uint8_t rx;
+    uint8_t tdr;
+    uint8_t tdr_full;
+    uint64_t tx_end;        //Cycle the shift register is empty.
+    uint64_t rx_cycle;      //Cycle the byte in DATAR was received.
+} usart;
+
+static struct {
+    uint32_t intfr;
+    uint32_t cntr;
+    uint32_t reload;
+    uint64_t rx_cycle;      //Cycle of the oldest byte not seen by a CNTR read.
+} dma;
+
+static struct {
+    uint32_t ctlr;
+    uint32_t statr;
+    uint32_t key;           //Last key written to each key register.
+    uint32_t obkey;
+    uint32_t modekey;
+    uint64_t busy_end;
+    uint32_t buffer[16];
+} flash;
+
+static struct {
+    uint32_t base;
+    uint64_t base_cycle;
+} systick;
+
+#define REG(adr)            periph[((adr) - PERIPH_BASE) / 4]
+
+static inline void wr32(uint8_t* p, uint32_t v){
+    memcpy(p, &v, 4);
+}
+
+/**
+ * @brief Cycles of a time in us at the current clock.
+ */
+static uint64_t us_cycles(uint32_t us){
+    return (uint64_t)us * hclk / 1000000u;
+}
+
+/**
+ * @brief A received byte seen by the firmware, keep the longest wait.
+ */
+static void rx_seen(uint64_t rx_cycle){
+    uint64_t latency = iss_cpu.cycles - rx_cycle;
+
+    if(latency > sim_stats->rx_latency_max){
+        sim_stats->rx_latency_max = (uint32_t)latency;
+    }
+}
+
+//-----------------------------------------------------------------
+//RCC
+
+/**
+ * @brief HCLK from SW and HPRE of CFGR0.
+ */
+static void rcc_update(void){
+    static const uint16_t hpre_div[16] = {1, 2, 3, 4, 5, 6, 7, 8, 2, 4, 8, 16, 32, 64, 128, 256};
+    uint32_t cfgr0 = REG(RCC_CFGR0);
+    uint32_t sysclk = ((cfgr0 & 3) == 2) ? 2 * HSI_HZ : HSI_HZ;
+
+    hclk = sysclk / hpre_div[(cfgr0 >> 4) & 0xF];
+    iss_ps_per_cycle = (uint32_t)(1000000000000ull / hclk);
+    sim_stats->hclk = hclk;
+}
+
+//-----------------------------------------------------------------
+//USART1
+
+/**
+ * @brief BRR as seen by the hub, which assumes SIM_CLOCK_HZ.
+ */
+static uint16_t usart_bus_brr(void){
+    return (uint16_t)((uint64_t)(REG(USART_BRR) & 0xFFFF) * SIM_CLOCK_HZ / hclk);
+}
+
+static uint32_t brr_match(uint16_t a, uint16_t b){
+    uint32_t diff = (a > b) ? a - b : b - a;
+    return diff * 100 <= (uint32_t)a * 3;
+}
+
+/**
+ * @brief Start shifting out a byte, the hub puts it in the next bus slot.
+ */
+static void usart_shift(uint8_t byte){
+    //Start, 8 data and stop bit.
+    usart.tx_end = iss_cpu.cycles + 10u * (REG(USART_BRR) & 0xFFFF);
+    iss_bus_send(byte, usart_bus_brr());
+    if(usart.tx_end < iss_next_event){
+        iss_next_event = usart.tx_end;
+    }
+}
+
+static void usart_event(void){
+    if(usart.tx_end && iss_cpu.cycles >= usart.tx_end){
+        usart.tx_end = 0;
+        if(usart.tdr_full){
+            usart.tdr_full = 0;
+            usart_shift(usart.tdr);
+        }
+    }
+    if(usart.tx_end){
+        iss_next_event = usart.tx_end;
+    }
+}
+
+static uint32_t usart_statr(void){
+    uint32_t statr = usart.statr;
+
+    if(!usart.tdr_full){
+        statr |= USART_TXE;
+        if(usart.tx_end == 0 || iss_cpu.cycles >= usart.tx_end){
+            statr |= USART_TC;
+        }
+    }
+    return statr;
+}
+
+static uint32_t usart_datar_read(void){
+    if(usart.statr & USART_RXNE){
+        rx_seen(usart.rx_cycle);
+    }
+    usart.statr &= ~(USART_RXNE | USART_ORE | USART_FE);
+    return usart.rx;
+}
+
+static void usart_datar_write(uint32_t value){
+    uint32_t on = USART_UE | USART_TE;
+
+    if((REG(USART_CTLR1) & on) != on){
+        return;
+    }
+    if(usart.tx_end == 0 || iss_cpu.cycles >= usart.tx_end){
+        usart_shift((uint8_t)value);
+    }else{
+        //Shift register busy, kept in DATAR until the byte is out.
+        usart.tdr = (uint8_t)value;
+        usart.tdr_full = 1;
+    }
+}
+
+/**
+ * @brief DMA1 channel 5 moves a received byte to memory.
+ */
+static void dma_rx(uint8_t byte){
+    uint32_t cfgr = REG(DMA_CH5_CFGR);
+    uint32_t adr = REG(DMA_CH5_MADDR) + ((cfgr & DMA_MINC) ? dma.reload - dma.cntr : 0);
+
+    if(dma.cntr == 0 || !iss_store(adr, 1, byte)){
+        return;
+    }
+
+    if(dma.rx_cycle == 0){
+        dma.rx_cycle = iss_cpu.cycles;
+    }
+    dma.cntr--;
+    if(dma.cntr == dma.reload / 2){
+        dma.intfr |= DMA_GIF5 | DMA_HTIF5;
+    }
+    if(dma.cntr == 0){
+        dma.intfr |= DMA_GIF5 | DMA_TCIF5;
+        if(cfgr & DMA_CIRC){
+            dma.cntr = dma.reload;
+        }
+    }
+}
+
+void iss_uart_rx(const SimBusByte_t* msg){
+    uint32_t on = USART_UE | USART_RE;
+
+    if((REG(USART_CTLR1) & on) != on){
+        return;
+    }
+    if(!brr_match(usart_bus_brr(), msg->brr)){
+        usart.statr |= USART_FE;
+        sim_stats->frame_errors++;
+        return;
+    }
+
+    if((REG(USART_CTLR3) & USART_DMAR) && (REG(DMA_CH5_CFGR) & DMA_EN)){
+        dma_rx(msg->byte);
+        return;
+    }
+
+    //DATAR not read since the last byte.
+    if(usart.statr & USART_RXNE){
+        usart.statr |= USART_ORE;
+        sim_stats->overruns++;
+        return;
+    }
+    usart.rx = msg->byte;
+    usart.rx_cycle = iss_cpu.cycles;
+    usart.statr |= USART_RXNE;
+}
+
+//-----------------------------------------------------------------
+//FLASH controller
+
+static void fill_erased(uint8_t* p, uint32_t len){
+    for(uint32_t i = 0; i < len; i += 4){
+        wr32(p + i, ERASED_WORD);
+    }
+}
+
+static void flash_busy(uint32_t us){
+    flash.busy_end = iss_cpu.cycles + us_cycles(us);
+    flash.statr |= SR_BSY;
+}
+
+/**
+ * @brief Unlock sequence, key 1 followed by key 2.
+ */
+static uint32_t flash_key(uint32_t* last, uint32_t value){
+    uint32_t ok = (*last == FLASH_KEY1 && value == FLASH_KEY2);
+
+    *last = value;
+    return ok;
+}
+
+/**
+ * @brief Application flash offset of ADDR, or -1 when outside.
+ */
+static int32_t flash_offset(uint32_t mask){
+    uint32_t adr = REG(FLASH_ADDR) - SIM_FLASH_BASE;
+
+    return (adr < SIM_FLASH_SIZE) ? (int32_t)(adr & ~mask) : -1;
+}
+
+static void flash_start(uint32_t mode){
+    int32_t ofs;
+
+    if((flash.ctlr & CR_LOCK) || ((mode & (CR_PAGE_ER | CR_PAGE_PG)) && (flash.ctlr & CR_FLOCK))
+        || ((mode & CR_OPTER) && !(flash.ctlr & CR_OBWRE))){
+        flash.statr |= SR_WRPRTERR;
+        return;
+    }
+
+    if(mode & CR_PAGE_ER){
+        if((ofs = flash_offset(63)) >= 0){
+            fill_erased(iss_flash + ofs, 64);
+            flash_busy(SIM_PAGE_ERASE_US);
+        }
+    }else if(mode & CR_PER){
+        if((ofs = flash_offset(1023)) >= 0){
+            fill_erased(iss_flash + ofs, 1024);
+            flash_busy(SIM_SECTOR_ERASE_US);
+        }
+    }else if(mode & CR_MER){
+        fill_erased(iss_flash, SIM_FLASH_SIZE);
+        flash_busy(SIM_MASS_ERASE_US);
+    }else if(mode & CR_PAGE_PG){
+        if((ofs = flash_offset(63)) >= 0){
+            memcpy(iss_flash + ofs, flash.buffer, 64);
+            flash_busy(SIM_PAGE_WRITE_US);
+        }
+    }else if(mode & CR_OPTER){
+        memset(iss_system + (SIM_OPTION_ADR - SIM_SYSTEM_BASE), 0xFF, OPTION_SIZE);
+        flash_busy(SIM_PAGE_ERASE_US);
+    }
+}
+
+static void flash_ctlr_write(uint32_t value){
+    const uint32_t locks = CR_LOCK | CR_FLOCK | CR_OBWRE;
+
+    //Lock bits only change by the keys or by writing LOCK.
+    flash.ctlr = (value & ~locks) | (flash.ctlr & locks);
+    if(value & CR_LOCK){
+        flash.ctlr = (flash.ctlr | CR_LOCK | CR_FLOCK) & ~CR_OBWRE;
+        return;
+    }
+    if(flash.ctlr & CR_LOCK){
+        return;
+    }
+
+    if((value & CR_BUF_RST) && (flash.ctlr & CR_PAGE_PG)){
+        for(int i = 0; i < 16; i++){
+            flash.buffer[i] = ERASED_WORD;
+        }
+    }
+    if(value & CR_STRT){
+        flash_start(flash.ctlr);
+    }
+
+    //Self clearing.
+    flash.ctlr &= ~(CR_STRT | CR_BUF_LOAD | CR_BUF_RST);
+}
+
+static uint32_t flash_statr(void){
+    if((flash.statr & SR_BSY) && iss_cpu.cycles >= flash.busy_end){
+        flash.statr = (flash.statr & ~SR_BSY) | SR_EOP;
+    }
+    return flash.statr;
+}
+
+static void flash_statr_write(uint32_t value){
+    //EOP and WRPRTERR are cleared by writing 1.
+    flash.statr &= ~(value & (SR_EOP | SR_WRPRTERR));
+    if(!(flash.ctlr & CR_LOCK)){
+        flash.statr = (flash.statr & ~SR_MODE) | (value & SR_MODE);
+    }
+}
+
+/**
+ * @brief Store to the application flash, a page buffer word or a half-word program.
+ */
+static int flash_store(uint32_t ofs, uint32_t size, uint32_t value){
+    if((flash.ctlr & CR_PAGE_PG) && !(flash.ctlr & (CR_LOCK | CR_FLOCK)) && size == 4){
+        flash.buffer[(ofs & 63) / 4] = value;
+        return 1;
+    }
+    if((flash.ctlr & CR_PG) && !(flash.ctlr & CR_LOCK) && size == 2){
+        memcpy(iss_flash + ofs, &value, 2);
+        flash_busy(SIM_PAGE_WRITE_US / 32);
+        return 1;
+    }
+    return 0;
+}
+
+/**
+ * @brief Option byte half-word, the hardware writes the inverted copy.
+ */
+static int option_store(uint32_t ofs, uint32_t size, uint32_t value){
+    if(!(flash.ctlr & CR_OPTPG) || !(flash.ctlr & CR_OBWRE) || size != 2){
+        return 0;
+    }
+    iss_system[ofs] = (uint8_t)value;
+    iss_system[ofs + 1] = (uint8_t)~value;
+    flash_busy((SIM_OPTION_WRITE_US - SIM_PAGE_ERASE_US) / 6);
+    return 1;
+}
+
+//-----------------------------------------------------------------
+//SysTick and PFIC
+
+static uint32_t systick_cnt(void){
+    uint32_t ctlr = core[(SYSTICK_CTLR - CORE_BASE) / 4];
+
+    if(!(ctlr & SYSTICK_STE)){
+        return systick.base;
+    }
+    uint64_t ticks = iss_cpu.cycles - systick.base_cycle;
+    return systick.base + (uint32_t)((ctlr & SYSTICK_STCLK) ? ticks : ticks / 8);
+}
+
+static void core_write(uint32_t adr, uint32_t value){
+    uint32_t* reg = &core[(adr - CORE_BASE) / 4];
+
+    switch(adr){
+    case SYSTICK_CTLR:
+        //Count from here, keep the value while stopped.
+        systick.base = systick_cnt();
+        systick.base_cycle = iss_cpu.cycles;
+        break;
+    case SYSTICK_CNT:
+        systick.base = value;
+        systick.base_cycle = iss_cpu.cycles;
+        break;
+    case PFIC_CFGR:
+        if((value >> 16) == PFIC_KEY3 && (value & PFIC_RESETSYS)){
+            iss_reset = (flash.statr & SR_MODE) ? SIM_EXIT_RESET : SIM_EXIT_APP;
+        }
+        break;
+    }
+    *reg = value;
+}
+
+static uint32_t core_read(uint32_t adr){
+    if(adr == SYSTICK_CNT){
+        return systick_cnt();
+    }
+    return core[(adr - CORE_BASE) / 4];
+}
+
+//-----------------------------------------------------------------
+//Peripheral registers
+
+static uint32_t periph_read(uint32_t adr){
+    switch(adr){
+    case USART_STATR:   return usart_statr();
+    case USART_DATAR:   return usart_datar_read();
+    case DMA_INTFR:     return dma.intfr;
+    case DMA_CH5_CNTR:
+        //The firmware finds the new bytes in the ring.
+        if(dma.rx_cycle){
+            rx_seen(dma.rx_cycle);
+            dma.rx_cycle = 0;
+        }
+        return dma.cntr;
+    case FLASH_STATR:   return flash_statr();
+    case FLASH_CTLR:    return flash.ctlr;
+    }
+    return REG(adr);
+}
+
+static void periph_write(uint32_t adr, uint32_t value){
+    switch(adr){
+    case USART_DATAR:
+        usart_datar_write(value);
+        break;
+    case DMA_INTFCR:
+        dma.intfr &= ~value;
+        break;
+    case DMA_CH5_CNTR:
+        dma.cntr = dma.reload = value & 0xFFFF;
+        break;
+    case FLASH_KEYR:
+        if(flash_key(&flash.key, value)){
+            flash.ctlr &= ~CR_LOCK;
+        }
+        break;
+    case FLASH_OBKEYR:
+        if(flash_key(&flash.obkey, value)){
+            flash.ctlr |= CR_OBWRE;
+        }
+        break;
+    case FLASH_MODEKEYR:
+        if(flash_key(&flash.modekey, value)){
+            flash.ctlr &= ~CR_FLOCK;
+        }
+        break;
+    case FLASH_CTLR:
+        flash_ctlr_write(value);
+        return;
+    case FLASH_STATR:
+        flash_statr_write(value);
+        return;
+    }
+
+    REG(adr) = value;
+    if(adr == RCC_CFGR0){
+        rcc_update();
+    }
+}
+
+//-----------------------------------------------------------------
+//Memory map
+
+/**
+ * @brief Boot area at 0, system flash and application flash, read only.
+ */
+static const uint8_t* rom(uint32_t adr, uint32_t size){
+    if(adr + size <= SIM_SYSTEM_SIZE){
+        return iss_system + adr;
+    }
+    if(adr - SIM_SYSTEM_BASE <= SIM_SYSTEM_SIZE - size){
+        return iss_system + (adr - SIM_SYSTEM_BASE);
+    }
+    if(adr - SIM_FLASH_BASE <= SIM_FLASH_SIZE - size){
+        return iss_flash + (adr - SIM_FLASH_BASE);
+    }
+    return NULL;
+}
+
+int iss_fetch(uint32_t adr, uint16_t* half){
+    const uint8_t* p = rom(adr, 2);
+
+    if(p == NULL && adr - ISS_RAM_BASE <= ISS_RAM_SIZE - 2){
+        p = ram + (adr - ISS_RAM_BASE);
+    }
+    if(p == NULL){
+        return 0;
+    }
+    memcpy(half, p, 2);
+    return 1;
+}
+
+int iss_load(uint32_t adr, uint32_t size, uint32_t* value){
+    const uint8_t* p = rom(adr, size);
+    uint32_t word;
+
+    if(p == NULL && adr - ISS_RAM_BASE <= ISS_RAM_SIZE - size){
+        p = ram + (adr - ISS_RAM_BASE);
+    }
+    if(p){
+        *value = 0;
+        memcpy(value, p, size);
+        return 1;
+    }
+
+    //Registers are read as words, side effects for any size.
+    if(adr - PERIPH_BASE < PERIPH_SIZE){
+        word = periph_read(adr & ~3u);
+    }else if(adr - CORE_BASE < CORE_SIZE){
+        word = core_read(adr & ~3u);
+    }else{
+        return 0;
+    }
+
+    word >>= (adr & 3) * 8;
+    *value = (size == 4) ? word : word & ((1u << (size * 8)) - 1);
+    return 1;
+}
+
+int iss_store(uint32_t adr, uint32_t size, uint32_t value){
+    if(adr - ISS_RAM_BASE <= ISS_RAM_SIZE - size){
+        memcpy(ram + (adr - ISS_RAM_BASE), &value, size);
+        return 1;
+    }
+    if(adr - SIM_FLASH_BASE < SIM_FLASH_SIZE){
+        return flash_store(adr - SIM_FLASH_BASE, size, value);
+    }
+    if(adr - SIM_OPTION_ADR < OPTION_SIZE){
+        return option_store(adr - SIM_SYSTEM_BASE, size, value);
+    }
+
+    //Sub-word stores replace their lanes of the register.
+    uint32_t shift = (adr & 3) * 8;
+    uint32_t mask = (size == 4) ? 0xFFFFFFFFu : ((1u << (size * 8)) - 1) << shift;
+    uint32_t word = adr & ~3u;
+
+    if(adr - PERIPH_BASE < PERIPH_SIZE){
+        periph_write(word, (REG(word) & ~mask) | ((value << shift) & mask));
+    }else if(adr - CORE_BASE < CORE_SIZE){
+        core_write(word, (core[(word - CORE_BASE) / 4] & ~mask) | ((value << shift) & mask));
+    }else{
+        return 0;
+    }
+    return 1;
+}
+
+/**
+ * @brief Power on reset of the peripherals.
+ */
+void iss_mem_reset(void){
+    memset(ram, 0, sizeof(ram));
+    memset(periph, 0, sizeof(periph));
+    memset(core, 0, sizeof(core));
+    memset(&usart, 0, sizeof(usart));
+    memset(&dma, 0, sizeof(dma));
+    memset(&flash, 0, sizeof(flash));
+    memset(&systick, 0, sizeof(systick));
+
+    //HSI on, HCLK = HSI / 3. Booted from the system flash.
+    REG(RCC_BASE) = 0x00000083;
+    REG(RCC_CFGR0) = 0x00000020;
+    REG(USART_BRR) = 0;
+    flash.ctlr = CR_LOCK | CR_FLOCK;
+    flash.statr = SR_MODE;
+
+    rcc_update();
+    iss_next_event = UINT64_MAX;
+    iss_reset = 0;
+}
+
+void iss_mem_event(void){
+    iss_next_event = UINT64_MAX;
+    usart_event();
+}
@@ -0,0 +1,218 @@
+//
+//One instruction simulator node, runs the built bootloader ELF.
+//
+//The node time is the CPU cycle count at the RCC clock. It is kept a little
+//behind the hub (real time), so every bus byte that ended before the current
+//cycle is already in the socket and reaches USART1 at the right instruction.
+//
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <time.h>
+#include "iss.h"
+
+//Node time behind real time, run in slices to not sleep per instruction.
+#define SYNC_LAG_NS         200000
+#define SYNC_SLICE_NS       100000
+
+//Bytes from the hub not yet on the node time.
+#define RX_QUEUE            4096
+
+#define EM_RISCV            243
+#define PT_LOAD             1
+
+int sim_bus_fd = -1;
+SimNodeStats_t* sim_stats;
+
+static SimBusByte_t rx_queue[RX_QUEUE];
+static uint32_t rx_head;
+static uint32_t rx_tail;
+
+uint64_t sim_now_ns(void){
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+void iss_bus_send(uint8_t byte, uint16_t brr){
+    SimBusByte_t msg = {0, brr, byte};
+
+    send(sim_bus_fd, &msg, sizeof(msg), 0);
+    sim_stats->tx_bytes++;
+}
+
+/**
+ * @brief Queue the bytes from the hub.
+ */
+static void bus_receive(void){
+    while(rx_head - rx_tail < RX_QUEUE){
+        ssize_t n = recv(sim_bus_fd, &rx_queue[rx_head % RX_QUEUE], sizeof(SimBusByte_t), MSG_DONTWAIT);
+
+        if(n == 0){
+            //Hub is gone.
+            exit(0);
+        }
+        if(n != sizeof(SimBusByte_t)){
+            return;
+        }
+        rx_head++;
+    }
+}
+
+/**
+ * @brief Load the PT_LOAD segments of the bootloader at the system flash.
+ */
+static int load_elf(const char* path){
+    static uint8_t elf[64 * 1024];
+    FILE* f = fopen(path, "rb");
+
+    if(f == NULL){
+        perror(path);
+        return 0;
+    }
+    size_t len = fread(elf, 1, sizeof(elf), f);
+    fclose(f);
+
+    uint16_t machine, phentsize, phnum;
+    uint32_t phoff;
+    memcpy(&machine, elf + 18, 2);
+    memcpy(&phoff, elf + 28, 4);
+    memcpy(&phentsize, elf + 42, 2);
+    memcpy(&phnum, elf + 44, 2);
+
+    //32bit little endian RISC-V.
+    if(len < 52 || memcmp(elf, "\x7f" "ELF\x01\x01", 6) != 0 || machine != EM_RISCV
+        || phoff + (uint32_t)phnum * phentsize > len){
+        fprintf(stderr, "iss: %s is not a RV32 ELF\n", path);
+        return 0;
+    }
+
+    for(uint32_t i = 0; i < phnum; i++){
+        uint32_t ph[5];
+        memcpy(ph, elf + phoff + i * phentsize, sizeof(ph));
+
+        //type, offset, vaddr, paddr, filesz. Initialized data at its load address.
+        uint32_t adr = ph[3];
+        if(ph[0] != PT_LOAD || ph[4] == 0){
+            continue;
+        }
+        if(adr >= SIM_SYSTEM_BASE){
+            adr -= SIM_SYSTEM_BASE;
+        }
+        if(adr > ISS_BOOT_SIZE || ph[4] > ISS_BOOT_SIZE - adr || ph[1] + ph[4] > len){
+            fprintf(stderr, "iss: %s, segment 0x%08X-0x%08X is outside the %u byte boot area\n",
+                path, ph[3], ph[3] + ph[4], ISS_BOOT_SIZE);
+            return 0;
+        }
+        memcpy(iss_system + adr, elf + ph[1], ph[4]);
+    }
+    return 1;
+}
+
+/**
+ * @brief Stopped on a trap, print where.
+ */
+static void dump_trap(void){
+    static const char* const names[16] = {
+        "zero", "ra", "sp", "gp", "tp", "t0", "t1", "t2",
+        "s0", "s1", "a0", "a1", "a2", "a3", "a4", "a5"
+    };
+
+    fprintf(stderr, "iss: %s at pc 0x%08X (0x%08X), cycle %llu\n", rv32_trap_name(iss_cpu.trap),
+        iss_cpu.pc, iss_cpu.trap_value, (unsigned long long)iss_cpu.cycles);
+    for(int i = 0; i < 16; i++){
+        fprintf(stderr, "%4s 0x%08X%s", names[i], iss_cpu.x[i], (i % 4 == 3) ? "\n" : "  ");
+    }
+}
+
+/**
+ * @brief Add the cycles since the last call to the node statistics.
+ */
+static void publish_cycles(void){
+    static uint64_t cycles;
+    static uint64_t instret;
+
+    sim_stats->cycles += iss_cpu.cycles - cycles;
+    sim_stats->instructions += iss_cpu.instret - instret;
+    cycles = iss_cpu.cycles;
+    instret = iss_cpu.instret;
+}
+
+/**
+ * @brief Map the node memory, load the bootloader and run it from reset.
+ */
+int sim_node_run(int bus_fd, int mem_fd){
+    if(sim_elf_path == NULL){
+        fprintf(stderr, "iss: no bootloader, use --elf\n");
+        return SIM_EXIT_FATAL;
+    }
+
+    iss_flash = mmap(NULL, SIM_FLASH_SIZE, PROT_READ | PROT_WRITE, MAP_SHARED, mem_fd, SIM_MEM_FLASH);
+    iss_system = mmap(NULL, SIM_SYSTEM_SIZE, PROT_READ | PROT_WRITE, MAP_SHARED, mem_fd, SIM_MEM_SYSTEM);
+    sim_stats = mmap(NULL, sizeof(SimNodeStats_t), PROT_READ | PROT_WRITE, MAP_SHARED, mem_fd, SIM_MEM_STATS);
+    if(iss_flash == MAP_FAILED || iss_system == MAP_FAILED || sim_stats == MAP_FAILED){
+        perror("iss node mmap");
+        return SIM_EXIT_FATAL;
+    }
+    if(!load_elf(sim_elf_path)){
+        return SIM_EXIT_FATAL;
+    }
+
+    sim_stats->resets++;
+    sim_bus_fd = bus_fd;
+
+    iss_mem_reset();
+    rv32_reset(&iss_cpu, 0);
+
+    uint64_t start_ns = sim_now_ns();
+    uint64_t node_ps = 0;
+
+    while(1){
+        uint64_t now = sim_now_ns();
+        uint64_t node_ns = start_ns + node_ps / 1000;
+
+        //Ahead of the bus, wait for it.
+        if(node_ns + SYNC_LAG_NS + SYNC_SLICE_NS > now){
+            uint64_t t = node_ns + SYNC_LAG_NS + SYNC_SLICE_NS;
+            struct timespec ts = {t / 1000000000ull, t % 1000000000ull};
+            clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL);
+            continue;
+        }
+
+        bus_receive();
+
+        uint64_t until_ps = (now - SYNC_LAG_NS - start_ns) * 1000;
+        while(node_ps < until_ps){
+            //Bytes that ended on the bus before this cycle.
+            while(rx_tail != rx_head){
+                uint64_t t_ns = rx_queue[rx_tail % RX_QUEUE].t_ns;
+                if(t_ns > start_ns && (t_ns - start_ns) * 1000 > node_ps){
+                    break;
+                }
+                iss_uart_rx(&rx_queue[rx_tail++ % RX_QUEUE]);
+            }
+
+            if(iss_cpu.cycles >= iss_next_event){
+                iss_mem_event();
+            }
+
+            uint32_t cycles = rv32_step(&iss_cpu);
+            if(iss_cpu.trap){
+                publish_cycles();
+                dump_trap();
+                return 1;
+            }
+            node_ps += (uint64_t)cycles * iss_ps_per_cycle;
+
+            if(iss_reset){
+                publish_cycles();
+                return iss_reset;
+            }
+        }
+        publish_cycles();
+    }
+}
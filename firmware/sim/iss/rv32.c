@@ -0,0 +1,458 @@
+//
+//RV32EC instruction set simulator.
+//
+//Compressed instructions are expanded to the 32bit form and executed by the
+//same code. Every instruction is charged the cycles of its class below.
+//
+
+#include <string.h>
+#include "rv32.h"
+
+//Cycles per instruction class, QingKe V2A: 2 stage pipeline, flash without
+//wait states at 8MHz. Calibrate against the cycles/byte target report of
+//test/test_crc32_engines.
+#define CYCLES_ALU          1
+#define CYCLES_LOAD         2
+#define CYCLES_STORE        1
+#define CYCLES_BRANCH       1       //Not taken.
+#define CYCLES_TAKEN        2       //Taken branch, jal and jalr refill the pipeline.
+#define CYCLES_CSR          1
+
+//CSR numbers.
+#define CSR_MISA            0x301
+#define CSR_MEPC            0x341
+
+//RV32 E and C, MXL 32bit.
+#define MISA_RV32EC         ((1u << 30) | (1u << 4) | (1u << 2))
+
+//Instruction fields.
+#define RD(i)               (((i) >> 7) & 0x1F)
+#define RS1(i)              (((i) >> 15) & 0x1F)
+#define RS2(i)              (((i) >> 20) & 0x1F)
+#define FUNCT3(i)           (((i) >> 12) & 0x7)
+#define FUNCT7(i)           ((i) >> 25)
+
+#define IMM_I(i)            ((int32_t)(i) >> 20)
+#define IMM_S(i)            ((((int32_t)(i) >> 20) & ~0x1F) | (((i) >> 7) & 0x1F))
+#define IMM_B(i)            ((((int32_t)(i) >> 19) & ~0xFFF) | (((i) << 4) & 0x800) | \
+                             (((i) >> 20) & 0x7E0) | (((i) >> 7) & 0x1E))
+#define IMM_U(i)            ((i) & 0xFFFFF000u)
+#define IMM_J(i)            ((((int32_t)(i) >> 11) & ~0xFFFFF) | ((i) & 0xFF000) | \
+                             (((i) >> 9) & 0x800) | (((i) >> 20) & 0x7FE))
+
+//32bit encodings used by the compressed expansion.
+#define ENC_R(op, f3, f7, rd, rs1, rs2) \
+    ((uint32_t)(f7) << 25 | (uint32_t)(rs2) << 20 | (uint32_t)(rs1) << 15 | (f3) << 12 | (rd) << 7 | (op))
+#define ENC_I(op, f3, rd, rs1, imm) \
+    ((uint32_t)(imm) << 20 | (uint32_t)(rs1) << 15 | (f3) << 12 | (rd) << 7 | (op))
+#define ENC_S(op, f3, rs1, rs2, imm) \
+    (((uint32_t)(imm) >> 5) << 25 | (uint32_t)(rs2) << 20 | (uint32_t)(rs1) << 15 | \
+     (f3) << 12 | ((uint32_t)(imm) & 0x1F) << 7 | (op))
+#define ENC_B(f3, rs1, rs2, imm) \
+    (((uint32_t)(imm) >> 12 & 1) << 31 | ((uint32_t)(imm) >> 5 & 0x3F) << 25 | (uint32_t)(rs2) << 20 | \
+     (uint32_t)(rs1) << 15 | (f3) << 12 | ((uint32_t)(imm) >> 1 & 0xF) << 8 | \
+     ((uint32_t)(imm) >> 11 & 1) << 7 | 0x63)
+#define ENC_J(rd, imm) \
+    (((uint32_t)(imm) >> 20 & 1) << 31 | ((uint32_t)(imm) >> 1 & 0x3FF) << 21 | \
+     ((uint32_t)(imm) >> 11 & 1) << 20 | ((uint32_t)(imm) >> 12 & 0xFF) << 12 | (rd) << 7 | 0x6F)
+
+#define OP_LOAD             0x03
+#define OP_MISC_MEM         0x0F
+#define OP_IMM              0x13
+#define OP_AUIPC            0x17
+#define OP_STORE            0x23
+#define OP_OP               0x33
+#define OP_LUI              0x37
+#define OP_BRANCH           0x63
+#define OP_JALR             0x67
+#define OP_JAL              0x6F
+#define OP_SYSTEM           0x73
+
+//Bits of a compressed instruction, c[hi:lo] moved to bit pos.
+#define CBITS(c, hi, lo, pos)   ((((uint32_t)(c) >> (lo)) & ((1u << ((hi) - (lo) + 1)) - 1)) << (pos))
+
+//Sign extend the low bits.
+static inline int32_t sext(uint32_t value, uint32_t bits){
+    uint32_t shift = 32 - bits;
+    return (int32_t)(value << shift) >> shift;
+}
+
+/**
+ * @brief 32bit form of a compressed instruction, 0 when illegal.
+ */
+static uint32_t rv32_expand(uint16_t c){
+    uint32_t rd = CBITS(c, 11, 7, 0);
+    uint32_t rs2 = CBITS(c, 6, 2, 0);
+    uint32_t rdp = CBITS(c, 4, 2, 0) + 8;     //rd', rs2'
+    uint32_t rs1p = CBITS(c, 9, 7, 0) + 8;    //rs1', rd'
+    int32_t imm6 = sext(CBITS(c, 12, 12, 5) | CBITS(c, 6, 2, 0), 6);
+
+    switch(((c & 3) << 3) | (c >> 13)){
+    case 0x00:{ //c.addi4spn
+        uint32_t imm = CBITS(c, 12, 11, 4) | CBITS(c, 10, 7, 6) | CBITS(c, 6, 6, 2) | CBITS(c, 5, 5, 3);
+        return imm ? ENC_I(OP_IMM, 0, rdp, 2, imm) : 0;
+    }
+    case 0x02:  //c.lw
+        return ENC_I(OP_LOAD, 2, rdp, rs1p, CBITS(c, 12, 10, 3) | CBITS(c, 6, 6, 2) | CBITS(c, 5, 5, 6));
+    case 0x06:  //c.sw
+        return ENC_S(OP_STORE, 2, rs1p, rdp, CBITS(c, 12, 10, 3) | CBITS(c, 6, 6, 2) | CBITS(c, 5, 5, 6));
+
+    case 0x08:  //c.addi, c.nop
+        return ENC_I(OP_IMM, 0, rd, rd, imm6 & 0xFFF);
+    case 0x09:  //c.jal
+    case 0x0D:{ //c.j
+        int32_t imm = sext(CBITS(c, 12, 12, 11) | CBITS(c, 11, 11, 4) | CBITS(c, 10, 9, 8) |
+            CBITS(c, 8, 8, 10) | CBITS(c, 7, 7, 6) | CBITS(c, 6, 6, 7) | CBITS(c, 5, 3, 1) |
+            CBITS(c, 2, 2, 5), 12);
+        return ENC_J((c >> 13) == 1 ? 1 : 0, imm);
+    }
+    case 0x0A:  //c.li
+        return ENC_I(OP_IMM, 0, rd, 0, imm6 & 0xFFF);
+    case 0x0B:
+        if(rd == 2){
+            //c.addi16sp
+            int32_t imm = sext(CBITS(c, 12, 12, 9) | CBITS(c, 6, 6, 4) | CBITS(c, 5, 5, 6) |
+                CBITS(c, 4, 3, 7) | CBITS(c, 2, 2, 5), 10);
+            return imm ? ENC_I(OP_IMM, 0, 2, 2, imm & 0xFFF) : 0;
+        }
+        //c.lui
+        return imm6 ? ((uint32_t)imm6 << 12) | (rd << 7) | OP_LUI : 0;
+    case 0x0C:
+        switch((c >> 10) & 3){
+        case 0:     //c.srli
+            return (c & (1 << 12)) ? 0 : ENC_I(OP_IMM, 5, rs1p, rs1p, rs2);
+        case 1:     //c.srai
+            return (c & (1 << 12)) ? 0 : ENC_I(OP_IMM, 5, rs1p, rs1p, rs2 | 0x400);
+        case 2:     //c.andi
+            return ENC_I(OP_IMM, 7, rs1p, rs1p, imm6 & 0xFFF);
+        default:
+            if(c & (1 << 12)){
+                return 0;
+            }
+            switch((c >> 5) & 3){
+            case 0:  return ENC_R(OP_OP, 0, 0x20, rs1p, rs1p, rdp);   //c.sub
+            case 1:  return ENC_R(OP_OP, 4, 0, rs1p, rs1p, rdp);      //c.xor
+            case 2:  return ENC_R(OP_OP, 6, 0, rs1p, rs1p, rdp);      //c.or
+            default: return ENC_R(OP_OP, 7, 0, rs1p, rs1p, rdp);      //c.and
+            }
+        }
+    case 0x0E:  //c.beqz
+    case 0x0F:{ //c.bnez
+        int32_t imm = sext(CBITS(c, 12, 12, 8) | CBITS(c, 11, 10, 3) | CBITS(c, 6, 5, 6) |
+            CBITS(c, 4, 3, 1) | CBITS(c, 2, 2, 5), 9);
+        return ENC_B((c >> 13) == 6 ? 0 : 1, rs1p, 0, imm);
+    }
+
+    case 0x10:  //c.slli
+        return (c & (1 << 12)) ? 0 : ENC_I(OP_IMM, 1, rd, rd, rs2);
+    case 0x12:  //c.lwsp
+        return rd ? ENC_I(OP_LOAD, 2, rd, 2, CBITS(c, 12, 12, 5) | CBITS(c, 6, 4, 2) | CBITS(c, 3, 2, 6)) : 0;
+    case 0x14:
+        if(!(c & (1 << 12))){
+            if(rs2 == 0){
+                //c.jr
+                return rd ? ENC_I(OP_JALR, 0, 0, rd, 0) : 0;
+            }
+            //c.mv
+            return ENC_R(OP_OP, 0, 0, rd, 0, rs2);
+        }
+        if(rs2 == 0){
+            //c.ebreak, c.jalr
+            return rd ? ENC_I(OP_JALR, 0, 1, rd, 0) : 0x00100073;
+        }
+        //c.add
+        return ENC_R(OP_OP, 0, 0, rd, rd, rs2);
+    case 0x16:  //c.swsp
+        return ENC_S(OP_STORE, 2, 2, rs2, CBITS(c, 12, 9, 2) | CBITS(c, 8, 7, 6));
+    }
+    return 0;
+}
+
+void rv32_reset(Rv32_t* cpu, uint32_t pc){
+    memset(cpu, 0, sizeof(*cpu));
+    cpu->pc = pc;
+    cpu->csr[CSR_MISA] = MISA_RV32EC;
+}
+
+/**
+ * @brief Registers used by an instruction, RV32E has only x0-x15.
+ */
+static uint32_t rv32_regs(uint32_t inst){
+    switch(inst & 0x7F){
+    case OP_LUI:
+    case OP_AUIPC:
+    case OP_JAL:
+        return RD(inst);
+    case OP_BRANCH:
+    case OP_STORE:
+        return RS1(inst) | RS2(inst);
+    case OP_OP:
+        return RD(inst) | RS1(inst) | RS2(inst);
+    case OP_LOAD:
+    case OP_IMM:
+    case OP_JALR:
+        return RD(inst) | RS1(inst);
+    case OP_SYSTEM:
+        //csrrxi have an immediate in the rs1 field.
+        return FUNCT3(inst) == 0 ? 0 : RD(inst) | ((FUNCT3(inst) & 4) ? 0 : RS1(inst));
+    }
+    return 0;
+}
+
+static uint32_t trap(Rv32_t* cpu, uint32_t cause, uint32_t value){
+    cpu->trap = cause;
+    cpu->trap_value = value;
+    return 0;
+}
+
+/**
+ * @brief Zicsr, misa and the id registers are read only.
+ */
+static uint32_t rv32_csr(Rv32_t* cpu, uint32_t inst, uint32_t* result){
+    uint32_t num = inst >> 20;
+    uint32_t f3 = FUNCT3(inst);
+    uint32_t src = (f3 & 4) ? RS1(inst) : cpu->x[RS1(inst) & 0xF];
+    uint32_t old = cpu->csr[num];
+    uint32_t value = old;
+
+    switch(f3 & 3){
+    case 1: value = src; break;                          //csrrw
+    case 2: value = old | src; break;                    //csrrs
+    case 3: value = old & ~src; break;                   //csrrc
+    default: return 0;
+    }
+    if(num != CSR_MISA && (num >> 10) != 3){
+        cpu->csr[num] = value;
+    }
+    *result = old;
+    return 1;
+}
+
+uint32_t rv32_step(Rv32_t* cpu){
+    uint32_t pc = cpu->pc;
+    uint32_t next;
+    uint32_t inst;
+    uint16_t half;
+    uint32_t cycles = CYCLES_ALU;
+
+    if(pc & 1){
+        return trap(cpu, RV32_TRAP_FETCH_MISALIGNED, pc);
+    }
+    if(!iss_fetch(pc, &half)){
+        return trap(cpu, RV32_TRAP_FETCH_FAULT, pc);
+    }
+
+    if((half & 3) != 3){
+        inst = rv32_expand(half);
+        if(inst == 0){
+            return trap(cpu, RV32_TRAP_ILLEGAL, half);
+        }
+        next = pc + 2;
+    }else{
+        uint16_t upper;
+        if(!iss_fetch(pc + 2, &upper)){
+            return trap(cpu, RV32_TRAP_FETCH_FAULT, pc + 2);
+        }
+        inst = half | ((uint32_t)upper << 16);
+        next = pc + 4;
+    }
+
+    if(rv32_regs(inst) & 0x10){
+        return trap(cpu, RV32_TRAP_ILLEGAL, inst);
+    }
+
+    uint32_t rd = RD(inst);
+    //rs1/rs2 fields hold immediate bits in some formats.
+    uint32_t a = cpu->x[RS1(inst) & 0xF];
+    uint32_t b = cpu->x[RS2(inst) & 0xF];
+    uint32_t result = 0;
+    uint32_t write = 1;
+
+    switch(inst & 0x7F){
+    case OP_LUI:
+        result = IMM_U(inst);
+        break;
+
+    case OP_AUIPC:
+        result = pc + IMM_U(inst);
+        break;
+
+    case OP_JAL:
+        result = next;
+        next = pc + IMM_J(inst);
+        cycles = CYCLES_TAKEN;
+        break;
+
+    case OP_JALR:
+        if(FUNCT3(inst) != 0){
+            return trap(cpu, RV32_TRAP_ILLEGAL, inst);
+        }
+        result = next;
+        next = (a + IMM_I(inst)) & ~1u;
+        cycles = CYCLES_TAKEN;
+        break;
+
+    case OP_BRANCH:{
+        uint32_t taken;
+
+        write = 0;
+        switch(FUNCT3(inst)){
+        case 0: taken = (a == b); break;
+        case 1: taken = (a != b); break;
+        case 4: taken = ((int32_t)a < (int32_t)b); break;
+        case 5: taken = ((int32_t)a >= (int32_t)b); break;
+        case 6: taken = (a < b); break;
+        case 7: taken = (a >= b); break;
+        default: return trap(cpu, RV32_TRAP_ILLEGAL, inst);
+        }
+        cycles = CYCLES_BRANCH;
+        if(taken){
+            next = pc + IMM_B(inst);
+            cycles = CYCLES_TAKEN;
+        }
+        break;
+    }
+
+    case OP_LOAD:{
+        static const uint8_t sizes[8] = {1, 2, 4, 0, 1, 2, 0, 0};
+        uint32_t size = sizes[FUNCT3(inst)];
+        uint32_t adr = a + IMM_I(inst);
+
+        if(size == 0){
+            return trap(cpu, RV32_TRAP_ILLEGAL, inst);
+        }
+        if(adr & (size - 1)){
+            return trap(cpu, RV32_TRAP_LOAD_MISALIGNED, adr);
+        }
+        if(!iss_load(adr, size, &result)){
+            return trap(cpu, RV32_TRAP_LOAD_FAULT, adr);
+        }
+        switch(FUNCT3(inst)){
+        case 0: result = (uint32_t)sext(result, 8); break;
+        case 1: result = (uint32_t)sext(result, 16); break;
+        }
+        cycles = CYCLES_LOAD;
+        break;
+    }
+
+    case OP_STORE:{
+        uint32_t size = 1u << FUNCT3(inst);
+        uint32_t adr = a + IMM_S(inst);
+
+        write = 0;
+        if(FUNCT3(inst) > 2){
+            return trap(cpu, RV32_TRAP_ILLEGAL, inst);
+        }
+        if(adr & (size - 1)){
+            return trap(cpu, RV32_TRAP_STORE_MISALIGNED, adr);
+        }
+        if(!iss_store(adr, size, b)){
+            return trap(cpu, RV32_TRAP_STORE_FAULT, adr);
+        }
+        cycles = CYCLES_STORE;
+        break;
+    }
+
+    case OP_IMM:{
+        int32_t imm = IMM_I(inst);
+        uint32_t shamt = imm & 0x1F;
+
+        switch(FUNCT3(inst)){
+        case 0: result = a + imm; break;
+        case 2: result = ((int32_t)a < imm); break;
+        case 3: result = (a < (uint32_t)imm); break;
+        case 4: result = a ^ imm; break;
+        case 6: result = a | imm; break;
+        case 7: result = a & imm; break;
+        case 1:
+            if(FUNCT7(inst) != 0){
+                return trap(cpu, RV32_TRAP_ILLEGAL, inst);
+            }
+            result = a << shamt;
+            break;
+        default:
+            if(FUNCT7(inst) == 0){
+                result = a >> shamt;
+            }else if(FUNCT7(inst) == 0x20){
+                result = (uint32_t)((int32_t)a >> shamt);
+            }else{
+                return trap(cpu, RV32_TRAP_ILLEGAL, inst);
+            }
+            break;
+        }
+        break;
+    }
+
+    case OP_OP:
+        switch(FUNCT7(inst) << 3 | FUNCT3(inst)){
+        case 0x000: result = a + b; break;
+        case 0x100: result = a - b; break;
+        case 0x001: result = a << (b & 0x1F); break;
+        case 0x002: result = ((int32_t)a < (int32_t)b); break;
+        case 0x003: result = (a < b); break;
+        case 0x004: result = a ^ b; break;
+        case 0x005: result = a >> (b & 0x1F); break;
+        case 0x105: result = (uint32_t)((int32_t)a >> (b & 0x1F)); break;
+        case 0x006: result = a | b; break;
+        case 0x007: result = a & b; break;
+        default:
+            //No M extension on the QingKe V2A.
+            return trap(cpu, RV32_TRAP_ILLEGAL, inst);
+        }
+        break;
+
+    case OP_MISC_MEM:
+        //fence, fence.i, nothing is cached.
+        write = 0;
+        break;
+
+    case OP_SYSTEM:
+        if(FUNCT3(inst) == 0){
+            write = 0;
+                switch(inst){
+            case 0x00000073: return trap(cpu, RV32_TRAP_ECALL, pc);
+            case 0x00100073: return trap(cpu, RV32_TRAP_BREAKPOINT, pc);
+            case 0x10500073: break;                                 //wfi, no interrupts.
+            case 0x30200073:                                        //mret
+                next = cpu->csr[CSR_MEPC];
+                cycles = CYCLES_TAKEN;
+                break;
+            default: return trap(cpu, RV32_TRAP_ILLEGAL, inst);
+            }
+            break;
+        }
+        if(!rv32_csr(cpu, inst, &result)){
+            return trap(cpu, RV32_TRAP_ILLEGAL, inst);
+        }
+        cycles = CYCLES_CSR;
+        break;
+
+    default:
+        return trap(cpu, RV32_TRAP_ILLEGAL, inst);
+    }
+
+    if(write){
+        cpu->x[rd] = result;
+        cpu->x[0] = 0;
+    }
+
+    cpu->pc = next;
+    cpu->cycles += cycles;
+    cpu->instret++;
+    return cycles;
+}
+
+const char* rv32_trap_name(uint32_t trap){
+    switch(trap){
+    case RV32_TRAP_FETCH_MISALIGNED: return "instruction address misaligned";
+    case RV32_TRAP_FETCH_FAULT: return "instruction access fault";
+    case RV32_TRAP_ILLEGAL: return "illegal instruction";
+    case RV32_TRAP_BREAKPOINT: return "breakpoint";
+    case RV32_TRAP_LOAD_MISALIGNED: return "load address misaligned";
+    case RV32_TRAP_LOAD_FAULT: return "load access fault";
+    case RV32_TRAP_STORE_MISALIGNED: return "store address misaligned";
+    case RV32_TRAP_STORE_FAULT: return "store access fault";
+    case RV32_TRAP_ECALL: return "environment call";
+    }
+    return "none";
+}
@@ -0,0 +1,50 @@
+#ifndef RV32_H
+#define RV32_H
+
+#include <stdint.h>
+
+//
+//RV32EC instruction set simulator, the QingKe V2A core of the CH32V003.
+//Base integer (16 registers), compressed instructions and Zicsr.
+//
+
+//Trap causes (mcause), the simulator stops on any trap.
+#define RV32_TRAP_NONE              0
+#define RV32_TRAP_FETCH_MISALIGNED  (0 + 1)
+#define RV32_TRAP_FETCH_FAULT       (1 + 1)
+#define RV32_TRAP_ILLEGAL           (2 + 1)
+#define RV32_TRAP_BREAKPOINT        (3 + 1)
+#define RV32_TRAP_LOAD_MISALIGNED   (4 + 1)
+#define RV32_TRAP_LOAD_FAULT        (5 + 1)
+#define RV32_TRAP_STORE_MISALIGNED  (6 + 1)
+#define RV32_TRAP_STORE_FAULT       (7 + 1)
+#define RV32_TRAP_ECALL             (11 + 1)
+
+typedef struct {
+    uint32_t x[16];
+    uint32_t pc;
+    uint64_t cycles;
+    uint64_t instret;
+
+    //CSRs are only stored, no interrupts or traps are taken.
+    uint32_t csr[4096];
+
+    //Set by rv32_step, cause + 1 and the faulting address/instruction.
+    uint32_t trap;
+    uint32_t trap_value;
+} Rv32_t;
+
+//Memory of the node (iss_mem.c), size 1, 2 or 4. Return 0 on bus fault.
+int iss_load(uint32_t adr, uint32_t size, uint32_t* value);
+int iss_store(uint32_t adr, uint32_t size, uint32_t value);
+int iss_fetch(uint32_t adr, uint16_t* half);
+
+void rv32_reset(Rv32_t* cpu, uint32_t pc);
+
+//Execute one instruction, returns its cycles. cpu->trap is set and pc
+//is left on the instruction when it can not be executed.
+uint32_t rv32_step(Rv32_t* cpu);
+
+const char* rv32_trap_name(uint32_t trap);
+
+#endif
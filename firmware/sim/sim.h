@@ -0,0 +1,74 @@
+#ifndef SIM_H
+#define SIM_H
+
+#include <stdint.h>
+
+//
+//Shared definitions between the bus hub (sim_bus.c) and the node processes.
+//
+
+//Memory map of one node, same addresses as on the CH32V003.
+#define SIM_FLASH_BASE      0x08000000u
+#define SIM_FLASH_SIZE      0x4000u
+#define SIM_SYSTEM_BASE     0x1FFFF000u
+#define SIM_SYSTEM_SIZE     0x1000u
+#define SIM_UID_ADR         0x1FFFF7E8u
+#define SIM_OPTION_ADR      0x1FFFF800u
+
+//Node memory file: flash, system area (UID, option bytes) and statistics.
+#define SIM_MEM_FLASH       0
+#define SIM_MEM_SYSTEM      SIM_FLASH_SIZE
+#define SIM_MEM_STATS       (SIM_FLASH_SIZE + SIM_SYSTEM_SIZE)
+#define SIM_MEM_SIZE        (SIM_MEM_STATS + 4096)
+
+//Node exit codes, NVIC_SystemReset ends the process.
+#define SIM_EXIT_APP        10      //Reset into the application.
+#define SIM_EXIT_RESET      11      //Reset into the bootloader.
+#define SIM_EXIT_FATAL      12      //Node can not start, the hub stops.
+
+//Node clock, BRR = clock / baudrate.
+#define SIM_CLOCK_HZ        8000000u
+
+//Flash timing (us).
+#define SIM_PAGE_ERASE_US   2500
+#define SIM_SECTOR_ERASE_US 3000
+#define SIM_MASS_ERASE_US   10000
+#define SIM_PAGE_WRITE_US   2500
+#define SIM_OPTION_WRITE_US 6000
+
+//One byte on the bus.
+typedef struct {
+    uint64_t t_ns;          //Hub to node: end of the byte on the bus (CLOCK_MONOTONIC).
+                            //Node to hub: not sent before, 0 as soon as possible.
+    uint16_t brr;           //Baudrate of the sender as BRR.
+    uint8_t  byte;
+} SimBusByte_t;
+
+//Node statistics, written by the node, read by the hub.
+typedef struct {
+    volatile uint32_t resets;
+    volatile uint32_t overruns;     //Bytes lost while flash was busy.
+    volatile uint32_t frame_errors; //Bytes received at a different baudrate.
+    volatile uint32_t tx_bytes;
+
+    //Instruction simulator (sim/iss) only.
+    volatile uint32_t hclk;             //CPU clock of the cycle counts.
+    volatile uint32_t rx_latency_max;   //Cycles from a received byte until the firmware read it.
+    volatile uint64_t cycles;
+    volatile uint64_t instructions;
+} SimNodeStats_t;
+
+//Node side, called after fork.
+int sim_node_run(int bus_fd, int mem_fd);
+
+//Bootloader ELF run by the instruction simulator (--elf).
+extern const char* sim_elf_path;
+
+//Internal to the node.
+extern int sim_bus_fd;
+extern uint8_t sim_boot_user;
+extern SimNodeStats_t* sim_stats;
+void sim_busy(uint32_t us);
+uint64_t sim_now_ns(void);
+
+#endif
@@ -0,0 +1,690 @@
+//
+//Multi-node bus simulator.
+//
+//Every node is a process running the real bootloader (src/main.c, packet and
+//crc libraries) with UART and flash replaced by sim_uart.c/sim_flash.c.
+//The hub connects the nodes to a pseudo-terminal, uploader.py use it as a
+//serial port:
+//
+//  pio run -e sim -t exec -a "-n 50 -l /tmp/ttyBUS"
+//  python uploader.py --port /tmp/ttyBUS --search
+//
+//Built with sim/iss/ instead (env:iss), the nodes run the target ELF given
+//by --elf on an instruction simulator.
+//
+//Bus model:
+//  - One byte per slot, slot time from the baudrate of the sender. For the host
+//    it is the baudrate uploader.py had set on the pty when writing the byte.
+//  - Open-drain, bytes sent in the same slot by several drivers are AND:ed.
+//  - Node bytes wait for the bus time the node intends to send them (reply
+//    slots). A hub behind real time catches up on queued replies in bus time,
+//    they keep their slots instead of landing on top of each other.
+//  - Every byte is received by all nodes and the host (half-duplex echo).
+//  - Receivers with a different baudrate (>3%) get a framing error.
+//  - A node only keep the first byte received while flash is busy (overrun).
+//  - A long 0x7F sync from the host power cycle the nodes, as done by hand
+//    on real hardware while the uploader hold the bus in sync.
+//
+
+#define _GNU_SOURCE
+#include <errno.h>
+#include <fcntl.h>
+#include <getopt.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+#include "sim.h"
+
+//main.c is built with -Dmain=bootloader_main.
+#undef main
+
+#define MAX_NODES           1000
+#define NODE_TX_QUEUE       2048
+#define HOST_TX_QUEUE       (256 * 1024)
+
+//Host sync bytes kept in the queue, a USB adapter only buffer a few KB.
+#define HOST_FLOOD_MAX      512
+
+//Host sync bytes on the bus that power cycle the nodes.
+#define POWER_CYCLE_SYNC    64
+
+typedef enum { NODE_OFF, NODE_BOOT, NODE_APP } NodeState_t;
+
+typedef struct {
+    NodeState_t state;
+    pid_t pid;
+    int fd;
+    int mem_fd;
+    uint8_t* mem;
+    SimBusByte_t tx[NODE_TX_QUEUE];
+    uint32_t tx_head;
+    uint32_t tx_tail;
+} SimNode_t;
+
+static SimNode_t* nodes;
+static uint32_t node_count = 8;
+static uint8_t fw_id;
+static uint64_t uid_seed = 0x5EED;
+static const char* link_path;
+const char* sim_elf_path;
+static int power_cycle_on_sync = 1;
+static int verbose;
+
+static int master_fd = -1;
+static int slave_fd = -1;
+
+//Host bytes keep the baudrate they were written with, the pty does not
+//wait for the bytes to leave before the uploader change baudrate.
+typedef struct {
+    uint8_t byte;
+    uint16_t brr;
+    uint32_t slot_ns;
+} HostByte_t;
+
+static HostByte_t host_tx[HOST_TX_QUEUE];
+static uint16_t host_brr = 833;
+static uint32_t host_head;
+static uint32_t host_tail;
+static uint32_t host_flood;
+static uint32_t host_sync;
+
+static volatile sig_atomic_t stop;
+static volatile sig_atomic_t power_cycle;
+
+static struct {
+    uint64_t slots;
+    uint64_t host_bytes;
+    uint64_t node_bytes;
+    uint64_t collisions;
+    uint64_t host_dropped;
+    uint64_t node_dropped;
+    uint64_t late_slots;
+} stats;
+
+static uint64_t now_ns(void){
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+static void sleep_until(uint64_t t_ns){
+    struct timespec ts = {t_ns / 1000000000ull, t_ns % 1000000000ull};
+    clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL);
+}
+
+static uint64_t splitmix64(uint64_t* x){
+    uint64_t z = (*x += 0x9E3779B97F4A7C15ull);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+    return z ^ (z >> 31);
+}
+
+static uint32_t brr_match(uint16_t a, uint16_t b){
+    uint32_t diff = (a > b) ? a - b : b - a;
+    return diff * 100 <= (uint32_t)a * 3;
+}
+
+/**
+ * @brief Baudrate and bits per byte set on the pty by the uploader.
+ */
+static void host_timing(uint32_t* baud, uint32_t* bits){
+    static const struct { speed_t code; uint32_t baud; } speeds[] = {
+        {B1200, 1200}, {B2400, 2400}, {B4800, 4800}, {B9600, 9600}, {B19200, 19200},
+        {B38400, 38400}, {B57600, 57600}, {B115200, 115200}, {B230400, 230400},
+        {B460800, 460800}, {B500000, 500000}, {B576000, 576000}, {B921600, 921600},
+        {B1000000, 1000000}, {B1152000, 1152000}, {B1500000, 1500000}, {B2000000, 2000000},
+    };
+    struct termios tio;
+
+    *baud = 9600;
+    *bits = 10;
+    if(tcgetattr(slave_fd, &tio) != 0){
+        return;
+    }
+
+    speed_t code = cfgetospeed(&tio);
+    for(size_t i = 0; i < sizeof(speeds) / sizeof(speeds[0]); i++){
+        if(speeds[i].code == code){
+            *baud = speeds[i].baud;
+        }
+    }
+
+    //Start + 8 data + stop bits + parity.
+    *bits = 10 + ((tio.c_cflag & CSTOPB) ? 1 : 0) + ((tio.c_cflag & PARENB) ? 1 : 0);
+    host_brr = (uint16_t)((SIM_CLOCK_HZ + *baud / 2) / *baud);
+}
+
+/**
+ * @brief Initial memory of a node: erased flash, UID and option bytes.
+ */
+static void node_memory_init(SimNode_t* n, uint32_t index){
+    uint32_t* flash = (uint32_t*)(n->mem + SIM_MEM_FLASH);
+    uint8_t* sys = n->mem + SIM_MEM_SYSTEM;
+    uint64_t seed = uid_seed + index;
+    uint64_t uid = splitmix64(&seed);
+    uint8_t node_id = (uint8_t)(index % 254 + 1);
+
+    for(uint32_t i = 0; i < SIM_FLASH_SIZE / 4; i++){
+        flash[i] = 0xE339E339;
+    }
+
+    memset(sys, 0xFF, SIM_SYSTEM_SIZE);
+    memcpy(sys + (SIM_UID_ADR - SIM_SYSTEM_BASE), &uid, 8);
+
+    uint8_t* ob = sys + (SIM_OPTION_ADR - SIM_SYSTEM_BASE);
+    ob[4] = node_id;
+    ob[5] = (uint8_t)~node_id;
+    ob[6] = fw_id;
+    ob[7] = (uint8_t)~fw_id;
+}
+
+/**
+ * @brief Start (power on) a node process.
+ */
+static void node_start(SimNode_t* n){
+    int sv[2];
+
+    if(socketpair(AF_UNIX, SOCK_SEQPACKET, 0, sv) != 0){
+        perror("socketpair");
+        exit(1);
+    }
+
+    int sndbuf = 1 << 20;
+    setsockopt(sv[0], SOL_SOCKET, SO_SNDBUF, &sndbuf, sizeof(sndbuf));
+
+    pid_t pid = fork();
+    if(pid < 0){
+        perror("fork");
+        exit(1);
+    }
+
+    if(pid == 0){
+        //Only keep the own bus socket and memory.
+        signal(SIGINT, SIG_DFL);
+        signal(SIGTERM, SIG_DFL);
+        signal(SIGUSR1, SIG_DFL);
+        close(master_fd);
+        close(slave_fd);
+        close(sv[0]);
+        for(uint32_t i = 0; i < node_count; i++){
+            if(nodes[i].fd >= 0){
+                close(nodes[i].fd);
+            }
+            if(&nodes[i] != n){
+                close(nodes[i].mem_fd);
+            }
+        }
+        //The hub keeps the bus clock, on a host with few cores a node
+        //holding the CPU would delay bytes into the next node's slot.
+        if(nice(10) == -1){
+            perror("nice");
+        }
+        exit(sim_node_run(sv[1], n->mem_fd));
+    }
+
+    close(sv[1]);
+    n->fd = sv[0];
+    n->pid = pid;
+    n->state = NODE_BOOT;
+    n->tx_head = n->tx_tail = 0;
+}
+
+/**
+ * @brief Stop a node process, memory is kept.
+ */
+static void node_stop(SimNode_t* n){
+    if(n->state == NODE_BOOT){
+        kill(n->pid, SIGKILL);
+        waitpid(n->pid, NULL, 0);
+    }
+    if(n->fd >= 0){
+        close(n->fd);
+        n->fd = -1;
+    }
+    n->state = NODE_OFF;
+}
+
+static void power_cycle_all(void){
+    for(uint32_t i = 0; i < node_count; i++){
+        node_stop(&nodes[i]);
+    }
+    for(uint32_t i = 0; i < node_count; i++){
+        node_start(&nodes[i]);
+    }
+    if(verbose){
+        fprintf(stderr, "sim: power cycle\n");
+    }
+}
+
+/**
+ * @brief Handle exited nodes, reset into bootloader or application.
+ */
+static void reap_nodes(void){
+    int status;
+    pid_t pid;
+
+    while((pid = waitpid(-1, &status, WNOHANG)) > 0){
+        for(uint32_t i = 0; i < node_count; i++){
+            SimNode_t* n = &nodes[i];
+            if(n->pid != pid || n->state != NODE_BOOT){
+                continue;
+            }
+
+            close(n->fd);
+            n->fd = -1;
+            n->state = NODE_OFF;
+
+            if(WIFEXITED(status) && WEXITSTATUS(status) == SIM_EXIT_APP){
+                //The application ignore the bus until next power cycle.
+                n->state = NODE_APP;
+            }else{
+                if(WIFEXITED(status) && WEXITSTATUS(status) == SIM_EXIT_FATAL){
+                    fprintf(stderr, "sim: node %u can not start, stopping\n", i);
+                    stop = 1;
+                    return;
+                }
+                if(!WIFEXITED(status) || WEXITSTATUS(status) != SIM_EXIT_RESET){
+                    fprintf(stderr, "sim: node %u crashed, restarting\n", i);
+                }
+                node_start(n);
+            }
+        }
+    }
+}
+
+/**
+ * @brief Move host and node output into the tx queues.
+ */
+static void collect_tx(int timeout_ms){
+    static struct pollfd pfd[MAX_NODES + 1];
+    static SimNode_t* pnode[MAX_NODES + 1];
+    nfds_t count = 0;
+
+    pfd[count].fd = master_fd;
+    pfd[count].events = POLLIN;
+    pnode[count++] = NULL;
+    for(uint32_t i = 0; i < node_count; i++){
+        if(nodes[i].state == NODE_BOOT){
+            pfd[count].fd = nodes[i].fd;
+            pfd[count].events = POLLIN;
+            pnode[count++] = &nodes[i];
+        }
+    }
+
+    if(poll(pfd, count, timeout_ms) <= 0){
+        return;
+    }
+
+    if(pfd[0].revents & POLLIN){
+        uint8_t buf[4096];
+        ssize_t len = read(master_fd, buf, sizeof(buf));
+        uint32_t baud, bits;
+
+        host_timing(&baud, &bits);
+
+        for(ssize_t i = 0; i < len; i++){
+            //Cap long sync floods, a real adapter block the writer instead.
+            host_flood = (buf[i] == 0x7F) ? host_flood + 1 : 0;
+            if(host_flood > HOST_FLOOD_MAX || host_head - host_tail == HOST_TX_QUEUE){
+                stats.host_dropped++;
+                continue;
+            }
+
+            HostByte_t* h = &host_tx[host_head++ % HOST_TX_QUEUE];
+            h->byte = buf[i];
+            h->brr = host_brr;
+            h->slot_ns = (uint32_t)(1000000000ull * bits / baud);
+        }
+    }
+
+    for(nfds_t p = 1; p < count; p++){
+        SimNode_t* n = pnode[p];
+        SimBusByte_t msg;
+
+        if(!(pfd[p].revents & POLLIN)){
+            continue;
+        }
+        while(n->tx_head - n->tx_tail < NODE_TX_QUEUE
+            && recv(n->fd, &msg, sizeof(msg), MSG_DONTWAIT) == sizeof(msg)){
+            n->tx[n->tx_head++ % NODE_TX_QUEUE] = msg;
+        }
+    }
+}
+
+/**
+ * @brief Any node with bytes waiting for the bus.
+ */
+static uint32_t nodes_sending(void){
+    for(uint32_t i = 0; i < node_count; i++){
+        if(nodes[i].state == NODE_BOOT && nodes[i].tx_head != nodes[i].tx_tail){
+            return 1;
+        }
+    }
+    return 0;
+}
+
+/**
+ * @brief Byte time of the next slot, the host or the first node sending.
+ */
+static uint64_t slot_time(void){
+    if(host_head != host_tail){
+        return host_tx[host_tail % HOST_TX_QUEUE].slot_ns;
+    }
+    for(uint32_t i = 0; i < node_count; i++){
+        SimNode_t* n = &nodes[i];
+        if(n->state == NODE_BOOT && n->tx_head != n->tx_tail){
+            //Node send 8N1.
+            return 10ull * n->tx[n->tx_tail % NODE_TX_QUEUE].brr * 1000000000ull / SIM_CLOCK_HZ;
+        }
+    }
+    return 0;
+}
+
+/**
+ * @brief Put one byte slot on the bus.
+ */
+static void bus_slot(uint64_t t_end){
+    SimBusByte_t bus = {t_end, 0, 0xFF};
+    uint32_t drivers = 0;
+    uint32_t garbled = 0;
+
+    if(host_head != host_tail){
+        HostByte_t* h = &host_tx[host_tail++ % HOST_TX_QUEUE];
+
+        bus.byte &= h->byte;
+        bus.brr = h->brr;
+        drivers++;
+        stats.host_bytes++;
+
+        //Host holding the bus in sync, power the nodes.
+        host_sync = (h->byte == 0x7F) ? host_sync + 1 : 0;
+        if(power_cycle_on_sync && host_sync == POWER_CYCLE_SYNC){
+            power_cycle = 1;
+        }
+    }
+
+    for(uint32_t i = 0; i < node_count; i++){
+        SimNode_t* n = &nodes[i];
+        if(n->state != NODE_BOOT || n->tx_head == n->tx_tail){
+            continue;
+        }
+
+        SimBusByte_t* m = &n->tx[n->tx_tail % NODE_TX_QUEUE];
+        if(m->t_ns >= t_end){
+            continue;
+        }
+        n->tx_tail++;
+        if(drivers && !brr_match(bus.brr, m->brr)){
+            garbled = 1;
+        }
+        bus.byte &= m->byte;
+        bus.brr = m->brr;
+        drivers++;
+        stats.node_bytes++;
+    }
+
+    //Idle bus, a node waits for its slot.
+    if(drivers == 0){
+        return;
+    }
+
+    stats.slots++;
+    if(drivers > 1){
+        stats.collisions++;
+    }
+    if(garbled){
+        //Drivers with different baudrates, nobody can decode it.
+        bus.brr = 1;
+    }
+
+    for(uint32_t i = 0; i < node_count; i++){
+        SimNode_t* n = &nodes[i];
+        if(n->state == NODE_BOOT && send(n->fd, &bus, sizeof(bus), MSG_DONTWAIT) != sizeof(bus)){
+            stats.node_dropped++;
+        }
+    }
+
+    if(brr_match(host_brr, bus.brr)){
+        if(write(master_fd, &bus.byte, 1) != 1){
+            stats.host_dropped++;
+        }
+    }
+}
+
+static void print_stats(void){
+    uint64_t overruns = 0;
+    uint64_t frame_errors = 0;
+    uint64_t resets = 0;
+    uint64_t cycles = 0;
+    uint64_t instructions = 0;
+    uint32_t latency_us = 0;
+    uint32_t in_app = 0;
+
+    for(uint32_t i = 0; i < node_count; i++){
+        SimNodeStats_t* s = (SimNodeStats_t*)(nodes[i].mem + SIM_MEM_STATS);
+        overruns += s->overruns;
+        frame_errors += s->frame_errors;
+        resets += s->resets;
+        in_app += (nodes[i].state == NODE_APP);
+
+        //Instruction simulator nodes.
+        uint32_t node_latency_us = 0;
+        if(s->hclk){
+            cycles += s->cycles;
+            instructions += s->instructions;
+            node_latency_us = (uint32_t)((uint64_t)s->rx_latency_max * 1000000 / s->hclk);
+            if(node_latency_us > latency_us){
+                latency_us = node_latency_us;
+            }
+        }
+
+        if(verbose){
+            fprintf(stderr, "node %3u: resets %u, tx %u, overruns %u, frame errors %u",
+                i, s->resets, s->tx_bytes, s->overruns, s->frame_errors);
+            if(s->hclk){
+                fprintf(stderr, ", %llu cycles, rx latency max %u us",
+                    (unsigned long long)s->cycles, node_latency_us);
+            }
+            fprintf(stderr, "\n");
+        }
+    }
+
+    fprintf(stderr, "sim: %llu slots, %llu host bytes, %llu node bytes, %llu collisions, %llu late slots\n",
+        (unsigned long long)stats.slots, (unsigned long long)stats.host_bytes,
+        (unsigned long long)stats.node_bytes, (unsigned long long)stats.collisions,
+        (unsigned long long)stats.late_slots);
+    fprintf(stderr, "sim: %llu overruns, %llu frame errors, %llu resets, %u of %u nodes in application\n",
+        (unsigned long long)overruns, (unsigned long long)frame_errors,
+        (unsigned long long)resets, in_app, node_count);
+    fprintf(stderr, "sim: dropped %llu host bytes, %llu node deliveries\n",
+        (unsigned long long)stats.host_dropped, (unsigned long long)stats.node_dropped);
+    if(instructions){
+        fprintf(stderr, "sim: %llu cycles, %.2f cycles per instruction, rx latency max %u us\n",
+            (unsigned long long)cycles, (double)cycles / instructions, latency_us);
+    }
+}
+
+static void on_stop(int sig){
+    (void)sig;
+    stop = 1;
+}
+
+static void on_power(int sig){
+    (void)sig;
+    power_cycle = 1;
+}
+
+static void usage(const char* name){
+    fprintf(stderr,
+        "Usage: %s [options]\n"
+        "  -n, --nodes N        number of nodes (default 8, max %d)\n"
+        "  -f, --fw ID          firmware id of all nodes (default 0)\n"
+        "  -s, --seed N         UID seed (default 0x5EED)\n"
+        "  -l, --link PATH      symlink to the bus pty\n"
+        "  -e, --elf PATH       bootloader ELF, instruction simulator build (env:iss)\n"
+        "      --no-power-cycle do not power cycle nodes on host sync\n"
+        "  -v, --verbose        per node statistics\n"
+        "SIGUSR1 power cycle all nodes, SIGINT print statistics and exit.\n",
+        name, MAX_NODES);
+}
+
+static void parse_args(int argc, char** argv){
+    static const struct option opts[] = {
+        {"nodes", required_argument, NULL, 'n'},
+        {"fw", required_argument, NULL, 'f'},
+        {"seed", required_argument, NULL, 's'},
+        {"link", required_argument, NULL, 'l'},
+        {"elf", required_argument, NULL, 'e'},
+        {"no-power-cycle", no_argument, NULL, 'P'},
+        {"verbose", no_argument, NULL, 'v'},
+        {"help", no_argument, NULL, 'h'},
+        {NULL, 0, NULL, 0}
+    };
+    int c;
+
+    while((c = getopt_long(argc, argv, "n:f:s:l:e:vh", opts, NULL)) != -1){
+        switch(c){
+        case 'n': node_count = (uint32_t)strtoul(optarg, NULL, 0); break;
+        case 'f': fw_id = (uint8_t)strtoul(optarg, NULL, 0); break;
+        case 's': uid_seed = strtoull(optarg, NULL, 0); break;
+        case 'l': link_path = optarg; break;
+        case 'e': sim_elf_path = optarg; break;
+        case 'P': power_cycle_on_sync = 0; break;
+        case 'v': verbose = 1; break;
+        default: usage(argv[0]); exit(c == 'h' ? 0 : 1);
+        }
+    }
+
+    if(node_count == 0 || node_count > MAX_NODES){
+        usage(argv[0]);
+        exit(1);
+    }
+}
+
+/**
+ * @brief Create the pty, raw 9600 8N1 until the uploader configure it.
+ */
+static void open_bus(void){
+    struct termios tio;
+
+    master_fd = posix_openpt(O_RDWR | O_NOCTTY);
+    if(master_fd < 0 || grantpt(master_fd) != 0 || unlockpt(master_fd) != 0){
+        perror("posix_openpt");
+        exit(1);
+    }
+
+    const char* name = ptsname(master_fd);
+
+    //Keep the slave open, else the master get EIO between uploader runs.
+    slave_fd = open(name, O_RDWR | O_NOCTTY);
+    if(slave_fd < 0){
+        perror(name);
+        exit(1);
+    }
+
+    tcgetattr(slave_fd, &tio);
+    cfmakeraw(&tio);
+    cfsetspeed(&tio, B9600);
+    tcsetattr(slave_fd, TCSANOW, &tio);
+
+    fcntl(master_fd, F_SETFL, fcntl(master_fd, F_GETFL) | O_NONBLOCK);
+
+    if(link_path){
+        unlink(link_path);
+        if(symlink(name, link_path) != 0){
+            perror(link_path);
+            exit(1);
+        }
+    }
+
+    printf("sim: %u nodes on %s\n", node_count, link_path ? link_path : name);
+    fflush(stdout);
+}
+
+int main(int argc, char** argv){
+    parse_args(argc, argv);
+    open_bus();
+
+    nodes = calloc(node_count, sizeof(SimNode_t));
+    for(uint32_t i = 0; i < node_count; i++){
+        SimNode_t* n = &nodes[i];
+
+        n->fd = -1;
+        n->mem_fd = memfd_create("sim-node", 0);
+        if(n->mem_fd < 0 || ftruncate(n->mem_fd, SIM_MEM_SIZE) != 0){
+            perror("memfd_create");
+            return 1;
+        }
+        n->mem = mmap(NULL, SIM_MEM_SIZE, PROT_READ | PROT_WRITE, MAP_SHARED, n->mem_fd, 0);
+        if(n->mem == MAP_FAILED){
+            perror("mmap");
+            return 1;
+        }
+        node_memory_init(n, i);
+    }
+
+    signal(SIGINT, on_stop);
+    signal(SIGTERM, on_stop);
+    signal(SIGUSR1, on_power);
+    signal(SIGPIPE, SIG_IGN);
+
+    for(uint32_t i = 0; i < node_count; i++){
+        node_start(&nodes[i]);
+    }
+
+    uint64_t next_slot = now_ns();
+    while(!stop){
+        reap_nodes();
+        if(power_cycle){
+            power_cycle = 0;
+            power_cycle_all();
+        }
+
+        //Idle bus, wait for data.
+        uint32_t baud, bits;
+        host_timing(&baud, &bits);
+        collect_tx(0);
+        uint64_t slot_ns = slot_time();
+        if(slot_ns == 0){
+            collect_tx(20);
+            next_slot = now_ns();
+            continue;
+        }
+
+        //Keep real time, restart the slot clock if we fall behind. Not while
+        //nodes have replies queued, those are sent without sleeping until
+        //caught up and keep their slots.
+        uint64_t now = now_ns();
+        if(next_slot + 10 * slot_ns < now){
+            stats.late_slots++;
+            if(!nodes_sending()){
+                next_slot = now;
+            }
+        }
+        next_slot += slot_ns;
+        sleep_until(next_slot);
+
+        bus_slot(next_slot);
+    }
+
+    //Before the stop, it turns the nodes off.
+    reap_nodes();
+    print_stats();
+    for(uint32_t i = 0; i < node_count; i++){
+        node_stop(&nodes[i]);
+    }
+
+    if(link_path){
+        unlink(link_path);
+    }
+    return 0;
+}
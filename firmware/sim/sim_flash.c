@@ -0,0 +1,71 @@
+//
+//Flash backend of a simulated node, the flash is mapped at the target address.
+//
+
+#include <string.h>
+#include "flash.h"
+#include "sim.h"
+
+uint8_t sim_boot_user;
+
+static void fill_erased(uint32_t adr, uint32_t len){
+    uint32_t* p = (uint32_t*)(uintptr_t)adr;
+
+    for(uint32_t i = 0; i < len / 4; i++){
+        p[i] = FLASH_ERASED_WORD;
+    }
+}
+
+void flash_boot_mode_user(void){
+    sim_boot_user = 1;
+}
+
+void flash_boot_mode_boot(void){
+    sim_boot_user = 0;
+}
+
+void flash_erase(uint32_t adr){
+    fill_erased(adr & ~63u, 64);
+    sim_busy(SIM_PAGE_ERASE_US);
+}
+
+void flash_erase_sector(uint32_t adr){
+    fill_erased(adr & ~1023u, 1024);
+    sim_busy(SIM_SECTOR_ERASE_US);
+}
+
+void flash_erase_all(void){
+    fill_erased(SIM_FLASH_BASE, SIM_FLASH_SIZE);
+    sim_busy(SIM_MASS_ERASE_US);
+}
+
+uint32_t flash_is_erased(uint32_t adr){
+    const uint32_t* p = (const uint32_t*)(uintptr_t)adr;
+
+    for(int i = 0; i < 16; i++){
+        if(p[i] != FLASH_ERASED_WORD){
+            return 0;
+        }
+    }
+    return 1;
+}
+
+uint32_t flash_is_equal(uint32_t adr, const uint8_t data[64]){
+    return memcmp((const void*)(uintptr_t)adr, data, 64) == 0;
+}
+
+void flash_write(uint32_t adr, uint8_t data[64]){
+    memcpy((void*)(uintptr_t)adr, data, 64);
+    sim_busy(SIM_PAGE_WRITE_US);
+}
+
+void flash_write_option_data(uint8_t data0, uint8_t data1){
+    volatile uint8_t* ob = (volatile uint8_t*)(uintptr_t)SIM_OPTION_ADR;
+
+    //Data0/Data1 with inverted copy, same layout as the option bytes.
+    ob[4] = data0;
+    ob[5] = (uint8_t)~data0;
+    ob[6] = data1;
+    ob[7] = (uint8_t)~data1;
+    sim_busy(SIM_OPTION_WRITE_US);
+}
@@ -0,0 +1,65 @@
+//
+//One simulated node, runs the real bootloader main() in its own process.
+//
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/mman.h>
+#include <ch32v00x.h>
+#include "sim.h"
+
+//main() of src/main.c, renamed with -Dmain=bootloader_main.
+int bootloader_main();
+
+RCC_TypeDef sim_rcc;
+AFIO_TypeDef sim_afio;
+GPIO_TypeDef sim_gpiod;
+
+SimNodeStats_t* sim_stats;
+
+void RCC_ClearFlag(void){
+}
+
+SysTick_Type* sim_systick(void){
+    static SysTick_Type systick;
+
+    systick.CNT = (uint32_t)(sim_now_ns() / 1000);
+    return &systick;
+}
+
+/**
+ * @brief The process ends, the hub restart it or keep it in the application.
+ */
+void NVIC_SystemReset(void){
+    exit(sim_boot_user ? SIM_EXIT_APP : SIM_EXIT_RESET);
+}
+
+/**
+ * @brief Map the node memory at the target addresses and start the bootloader.
+ */
+int sim_node_run(int bus_fd, int mem_fd){
+    if(sim_elf_path){
+        fprintf(stderr, "sim: --elf needs the instruction simulator build (env:iss)\n");
+        return SIM_EXIT_FATAL;
+    }
+
+    void* flash = mmap((void*)(uintptr_t)SIM_FLASH_BASE, SIM_FLASH_SIZE, PROT_READ | PROT_WRITE,
+        MAP_SHARED | MAP_FIXED_NOREPLACE, mem_fd, SIM_MEM_FLASH);
+    void* system = mmap((void*)(uintptr_t)SIM_SYSTEM_BASE, SIM_SYSTEM_SIZE, PROT_READ | PROT_WRITE,
+        MAP_SHARED | MAP_FIXED_NOREPLACE, mem_fd, SIM_MEM_SYSTEM);
+    void* stats = mmap(NULL, sizeof(SimNodeStats_t), PROT_READ | PROT_WRITE,
+        MAP_SHARED, mem_fd, SIM_MEM_STATS);
+
+    if(flash != (void*)(uintptr_t)SIM_FLASH_BASE || system != (void*)(uintptr_t)SIM_SYSTEM_BASE
+        || stats == MAP_FAILED){
+        perror("sim node mmap");
+        return 1;
+    }
+
+    sim_stats = stats;
+    sim_stats->resets++;
+    sim_bus_fd = bus_fd;
+
+    return bootloader_main();
+}
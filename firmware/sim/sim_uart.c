@@ -0,0 +1,182 @@
+//
+//UART backend of a simulated node, the bus is a SEQPACKET socket to the hub.
+//
+
+#define _GNU_SOURCE
+#include <poll.h>
+#include <stdlib.h>
+#include <sys/socket.h>
+#include <time.h>
+#include "uart.h"
+#include "sim.h"
+
+//Empty main loop iterations before sleeping, ~4.3us per loop on target.
+#define IDLE_LOOPS          1024
+#define IDLE_SLEEP_NS       (IDLE_LOOPS * 4300)
+
+int sim_bus_fd = -1;
+
+#if BOOT_FEATURE_STATS
+uint16_t uart_overruns;
+#endif
+
+static uint16_t brr = UART_BRR_DEFAULT;
+static uint8_t rx_data;
+static uint8_t rx_full;
+static uint32_t idle_loops;
+
+//Bytes kept while the CPU is busy, the DATAR register or the DMA ring.
+#if BOOT_FEATURE_UART_DMA
+#define BUSY_RX_MAX         BOOT_UART_RING_SIZE
+#else
+#define BUSY_RX_MAX         1
+#endif
+
+//Last flash busy period.
+static uint64_t busy_start;
+static uint64_t busy_end;
+static uint32_t busy_rx;
+
+//End of the last received byte on the bus.
+static uint64_t rx_last_ns;
+
+//Start of the reply slot, uart_delay() ends there in bus time.
+static uint64_t tx_due_ns;
+
+/**
+ * @brief Monotonic time, same clock as the hub.
+ */
+uint64_t sim_now_ns(void){
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+/**
+ * @brief CPU stalled by a flash operation, the USART keep receiving.
+ */
+void sim_busy(uint32_t us){
+    //Bus time, the node starts right after the byte that triggered it even
+    //when the host schedules it late. Consecutive operations follow each other.
+    uint64_t now = sim_now_ns();
+    busy_start = (busy_end > rx_last_ns) ? busy_end : rx_last_ns;
+    if(busy_start == 0 || busy_start > now){
+        busy_start = now;
+    }
+
+    //Nominal time, a late wakeup on a loaded host is not an overrun.
+    busy_end = busy_start + us * 1000ull;
+    busy_rx = 0;
+
+    struct timespec ts = {busy_end / 1000000000ull, busy_end % 1000000000ull};
+    clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL);
+}
+
+/**
+ * @brief Busy wait replacement, ~1us per loop.
+ */
+void uart_delay(uint32_t loops){
+    //Only used for reply slots. Bus time from the end of the request (or the
+    //flash work after it), a late wakeup does not move the reply into the
+    //next node's slot.
+    uint64_t start = (busy_end > rx_last_ns) ? busy_end : rx_last_ns;
+    if(start == 0){
+        start = sim_now_ns();
+    }
+
+    uint64_t end = start + loops * 1000ull;
+    tx_due_ns = end;
+    struct timespec ts = {end / 1000000000ull, end % 1000000000ull};
+    clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL);
+}
+
+/**
+ * @brief Baudrates within 3% can receive each other.
+ */
+static uint32_t brr_match(uint16_t a, uint16_t b){
+    uint32_t diff = (a > b) ? a - b : b - a;
+    return diff * 100 <= (uint32_t)a * 3;
+}
+
+void uart_write(uint8_t ch){
+    //A stale slot start is in the past, the hub sends it right away.
+    SimBusByte_t msg = {tx_due_ns, brr, ch};
+
+    send(sim_bus_fd, &msg, sizeof(msg), 0);
+    sim_stats->tx_bytes++;
+}
+
+uint32_t uart_available(void){
+    SimBusByte_t msg;
+
+    while(!rx_full){
+        //Idle, count main loop iterations and sleep for all of them at once
+        //to not burn the host CPU. Wakes up directly on new data.
+        if(idle_loops > 0){
+            if(++idle_loops < IDLE_LOOPS){
+                return 0;
+            }
+
+            struct pollfd pfd = {sim_bus_fd, POLLIN, 0};
+            struct timespec ts = {0, IDLE_SLEEP_NS};
+
+            idle_loops = 0;
+            ppoll(&pfd, 1, &ts, NULL);
+        }
+
+        ssize_t n = recv(sim_bus_fd, &msg, sizeof(msg), MSG_DONTWAIT);
+
+        if(n == 0){
+            //Hub is gone.
+            exit(0);
+        }
+
+        if(n != sizeof(msg)){
+            idle_loops = 1;
+            return 0;
+        }
+
+        //Overrun, the byte register was not read while flash was busy.
+        if(msg.t_ns >= busy_start && msg.t_ns < busy_end){
+            if(busy_rx >= BUSY_RX_MAX){
+                sim_stats->overruns++;
+#if BOOT_FEATURE_STATS
+                uart_overruns++;
+#endif
+                continue;
+            }
+            busy_rx++;
+        }
+
+        if(!brr_match(brr, msg.brr)){
+            sim_stats->frame_errors++;
+            continue;
+        }
+
+        rx_data = msg.byte;
+        rx_full = 1;
+        rx_last_ns = msg.t_ns;
+    }
+
+    return 1;
+}
+
+uint8_t uart_read(void){
+    rx_full = 0;
+    return rx_data;
+}
+
+void uart_init(void){
+    brr = UART_BRR_DEFAULT;
+}
+
+void uart_set_brr(uint16_t value){
+    brr = value;
+}
+
+uint16_t uart_get_brr(void){
+    return brr;
+}
+
+void uart_deinit(void){
+}
@@ -7,24 +7,69 @@
 //Get chip type
 #define BOOT_GET_CHIP       (0x02u)
 
+//Get error counters
+#define BOOT_GET_STATS      (0x03u)
+
 //Search commands
 #define BOOT_GET_ID         (0x11u)
 #define BOOT_SILENT         (0x12u)
 #define BOOT_UNSILENT       (0x13u)
+#define BOOT_SEARCH_UID     (0x14u)
+
+//Switch bus baudrate
+#define BOOT_SET_BAUD       (0x15u)
+
+//Wrapped query, answered in a time slot per node-id
+#define BOOT_SLOTTED        (0x16u)
 
 //Erase and Write FLASH
 #define BOOT_WRITE          (0x31)
 #define BOOT_ERASE          (0x44)
 
+//Write LZ packed pages
+#define BOOT_WRITE_PACKED   (0x32)
+
+//Number of written and skipped pages
+#define BOOT_GET_WRITE_STATS (0x35)
+
+//Bitmap of received pages
+#define BOOT_GET_WRITE_MAP  (0x36)
+
 //Change run address/reboot into flash.
 #define BOOT_GO             (0x21)
 
 //Calculate CRC32 of a area
 #define BOOT_GET_CRC32      (0xA1)
 
+//Calculate CRC32 of several consecutive blocks
+#define BOOT_GET_CRC_MAP    (0xA2)
+
+//Per sector CRC32 accumulated while writing
+#define BOOT_GET_WRITE_CRC  (0xA3)
+
 //Set node-id and/or firmware-id
 #define BOOT_GET_NODE_ID    (0xC1)
 #define BOOT_SET_NODE_ID    (0xC2)
 
 
+//Capability bits in BOOT_INFO response.
+#define BOOT_CAP_SET_BAUD       (1uL << 0)
+#define BOOT_CAP_EXT_FRAME      (1uL << 1)
+#define BOOT_CAP_CRC_MAP        (1uL << 2)
+#define BOOT_CAP_UID_SEARCH     (1uL << 3)
+#define BOOT_CAP_RANGE_ERASE    (1uL << 4)
+#define BOOT_CAP_SKIP_SAME      (1uL << 5)
+#define BOOT_CAP_WRITE_MAP      (1uL << 6)
+#define BOOT_CAP_STATS          (1uL << 7)
+#define BOOT_CAP_UART_DMA       (1uL << 8)
+#define BOOT_CAP_PACKED_WRITE   (1uL << 9)
+#define BOOT_CAP_WRITE_CRC      (1uL << 10)
+#define BOOT_CAP_BURST          (1uL << 11)
+#define BOOT_CAP_SLOTTED        (1uL << 12)
+#define BOOT_CAP_QUIET_VERIFY   (1uL << 13)
+#define BOOT_CAP_IAP_PACKET     (1uL << 14)
+#define BOOT_CAP_APP_CHECK      (1uL << 15)
+#define BOOT_CAP_WARM_ENTRY     (1uL << 16)
+
+
 #endif
\ No newline at end of file
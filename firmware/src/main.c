@@ -6,11 +6,70 @@
 #include "packet.h"
 #include "cmd.h"
 #include "uart.h"
+#include "unpack.h"
+#include "boot_config.h"
 
 //-----------------------------------------------------------------
 //Bootloader info
 #define BOOTLOADER_MAJOR    01
-#define BOOTLOADER_MINOR    01
+#define BOOTLOADER_MINOR    02
+
+//Capabilities, depends on enabled features.
+#define BOOTLOADER_CAPS     ( \
+    (BOOT_FEATURE_SET_BAUD ? BOOT_CAP_SET_BAUD : 0) | \
+    (BOOT_FEATURE_EXT_FRAME ? BOOT_CAP_EXT_FRAME : 0) | \
+    (BOOT_FEATURE_CRC_MAP ? BOOT_CAP_CRC_MAP : 0) | \
+    (BOOT_FEATURE_UID_SEARCH ? BOOT_CAP_UID_SEARCH : 0) | \
+    (BOOT_FEATURE_RANGE_ERASE ? BOOT_CAP_RANGE_ERASE : 0) | \
+    (BOOT_FEATURE_SKIP_SAME ? BOOT_CAP_SKIP_SAME : 0) | \
+    (BOOT_FEATURE_WRITE_MAP ? BOOT_CAP_WRITE_MAP : 0) | \
+    (BOOT_FEATURE_STATS ? BOOT_CAP_STATS : 0) | \
+    (BOOT_FEATURE_UART_DMA ? BOOT_CAP_UART_DMA : 0) | \
+    (BOOT_FEATURE_PACKED_WRITE ? BOOT_CAP_PACKED_WRITE : 0) | \
+    (BOOT_FEATURE_WRITE_CRC ? BOOT_CAP_WRITE_CRC : 0) | \
+    (BOOT_FEATURE_BURST ? BOOT_CAP_BURST : 0) | \
+    (BOOT_FEATURE_SLOTTED ? BOOT_CAP_SLOTTED : 0) | \
+    (BOOT_FEATURE_QUIET_VERIFY ? BOOT_CAP_QUIET_VERIFY : 0) | \
+    (BOOT_FEATURE_IAP_PACKET ? BOOT_CAP_IAP_PACKET : 0) | \
+    (BOOT_FEATURE_APP_CHECK ? BOOT_CAP_APP_CHECK : 0) | \
+    (BOOT_FEATURE_WARM_ENTRY ? BOOT_CAP_WARM_ENTRY : 0) \
+    )
+
+#if BOOT_FEATURE_EXT_FRAME
+//Header (6) + 1..16 pages.
+#define BOOT_WRITE_LEN_OK(len)  ((len) >= 70 && (((len) - 6) & 63) == 0)
+#else
+#define BOOT_WRITE_LEN_OK(len)  ((len) == 70)
+#endif
+
+#if BOOT_FEATURE_PACKED_WRITE
+//Same header as BOOT_WRITE, at least one token.
+#define BOOT_WRITE_PACKED_OK(cmd, len)  ((cmd) == BOOT_WRITE_PACKED && (len) > 6)
+#else
+#define BOOT_WRITE_PACKED_OK(cmd, len)  0
+#endif
+
+#if BOOT_FEATURE_QUIET_VERIFY
+//[Adr, Cnt] or [Adr, Cnt, Crc, FwId] answered only on mismatch.
+#define BOOT_CRC32_LEN_OK(len)  ((len) == 8 || (len) == 13)
+#else
+#define BOOT_CRC32_LEN_OK(len)  ((len) == 8)
+#endif
+
+#if BOOT_FEATURE_RANGE_ERASE
+//Single block or range.
+#define BOOT_ERASE_LEN_OK(len)  ((len) == 3 || (len) == 5)
+#else
+#define BOOT_ERASE_LEN_OK(len)  ((len) == 3)
+#endif
+
+//Main loop iterations (~4.3us) waiting for the host before the application starts.
+#define BOOT_WAIT_LOOPS     (1<<20)     //~4.5 seconds
+
+#if BOOT_FEATURE_APP_CHECK
+//Application length and CRC32, last 8 bytes of flash (uploader --trailer).
+#define APP_TRAILER_ADR     0x08003FF8
+#endif
 
 const uint8_t chip_name[] = {
     0x43, 0x48, 0x33, 0x32, 
@@ -25,15 +84,51 @@ uint32_t memcmp64(const uint8_t *id1, const uint8_t *id2);
 void GetChipID64(uint8_t *dest);
 void bootloader_start_app(void);
 void process_packet(Packet_t* rx);
+void program_page(uint32_t adr, uint8_t* page);
 void initialize(void);
 void deinitilize(void);
 
 Packet_t packet;
 uint8_t tx_buffer[128];
-uint8_t tx_data[64];
+uint8_t tx_data[64] __attribute__((aligned(4)));
 uint8_t stay_silent=0;
 uint32_t boot_timeout = 0;
 
+#if BOOT_FEATURE_WARM_ENTRY
+//BOOT_WARM_ADR at reset, set by the startup (startup_min.S).
+uint32_t boot_warm;
+#endif
+#if BOOT_FEATURE_SET_BAUD
+uint32_t baud_timeout = 0;
+#endif
+#if BOOT_FEATURE_SKIP_SAME
+//Programmed and skipped pages.
+uint16_t write_stats[2];
+#endif
+#if BOOT_FEATURE_WRITE_MAP
+//One bit per 64 byte page of the 16KB application flash.
+uint8_t write_map[32] __attribute__((aligned(4)));
+#endif
+#if BOOT_FEATURE_WRITE_CRC
+//Running CRC32 state per 1KB sector and pages added in order from the
+//sector start, 0xFF when a page came out of order.
+uint32_t write_crc[16];
+uint8_t write_crc_pages[16] __attribute__((aligned(4)));
+#endif
+#if BOOT_FEATURE_STATS
+//Node counters, packet_stats and uart_overruns are kept by the libraries.
+typedef struct {
+    uint16_t addr_mismatch;     //Requests for other nodes.
+    uint16_t fw_reject;         //Erase/write for other firmware-id.
+    uint32_t busy_us;           //Time in process_packet, RX not polled.
+} NodeStats_t;
+
+NodeStats_t node_stats;
+#define STATS_INC(x)    (node_stats.x++)
+#else
+#define STATS_INC(x)
+#endif
+
 /**
  * @brief Fast variant to compare 64bit values.
  */
@@ -77,6 +172,25 @@ uint8_t get_firmware_id(void){
 
 
 
+#if BOOT_FEATURE_APP_CHECK
+/**
+ * @brief Time to wait for the host, from the application trailer.
+ * @return Main loop iterations before the application is started.
+ */
+uint32_t app_boot_wait(void){
+    const uint32_t* trailer = (const uint32_t*)APP_TRAILER_ADR;
+    uint32_t len = trailer[0];
+
+    //No trailer, or a damaged application. Normal wait, a stale trailer
+    //must not keep the node in the bootloader.
+    if(len - 1 >= APP_TRAILER_ADR - 0x08000000
+        || crc32_calc((const uint8_t*)0x08000000, len) != trailer[1]){
+        return BOOT_WAIT_LOOPS;
+    }
+    return BOOT_SNIFF_LOOPS;
+}
+#endif
+
 /**
  * @brief Start the applicaton
  */
@@ -87,6 +201,65 @@ void bootloader_start_app(void){
 
 }
 
+#if BOOT_FEATURE_WARM_ENTRY
+/**
+ * @brief Reset into the bootloader with the session active, IAP table entry.
+ * Runs on the application RAM and gp, BOOT_WARM_ADR is a constant address.
+ */
+void boot_warm_entry(void){
+    flash_boot_mode_boot();
+    *(volatile uint32_t*)BOOT_WARM_ADR = BOOT_WARM_MAGIC;
+    NVIC_SystemReset();
+    while(1){};
+}
+#endif
+
+/**
+ * @brief Program one 64 byte page.
+ */
+void program_page(uint32_t adr, uint8_t* page){
+#if BOOT_FEATURE_WRITE_MAP
+    //Mark page as received, also if it is skipped below.
+    uint32_t index = (uint8_t)((adr - 0x08000000) >> 6);
+    write_map[index >> 3] |= (1u << (index & 7));
+#endif
+
+#if BOOT_FEATURE_WRITE_CRC
+    //Page 0 starts the sector over, the next page in order is added.
+    uint32_t sector = ((adr - 0x08000000) >> 10) & 15;
+    uint32_t sector_page = (adr >> 6) & 15;
+
+    if(sector_page == 0){
+        crc32_init(&write_crc[sector]);
+        write_crc_pages[sector] = 0;
+    }
+    if(write_crc_pages[sector] == sector_page){
+        crc32_update(&write_crc[sector], page, 64);
+        write_crc_pages[sector]++;
+    }else{
+        write_crc_pages[sector] = 0xFF;
+    }
+#endif
+
+#if BOOT_FEATURE_SKIP_SAME
+    //Page already hold the data, no erase/write needed.
+    if(flash_is_equal(adr, page)){
+        write_stats[1]++;
+        return;
+    }
+    write_stats[0]++;
+#endif
+
+#if BOOT_FEATURE_RANGE_ERASE
+    //Pages erased by a range erase do not need a new erase.
+    if(!flash_is_erased(adr))
+#endif
+    {
+        flash_erase(adr);
+    }
+    flash_write(adr, page);
+}
+
 /**
  * @brief Process incomming packet
  */
@@ -106,17 +279,36 @@ void process_packet(Packet_t* rx){
         uint8_t adr8 = rx->address[0];
         isBroadcast = (adr8 == 0xFF); 
         if((adr8 != node_id) && !isBroadcast){
+            STATS_INC(addr_mismatch);
             return;
         } 
     }else{
         //check if the UID match.
         if(memcmp64(rx->address, chip_id) == 0){
+            STATS_INC(addr_mismatch);
             return;
         }
     }
 
+#if BOOT_FEATURE_SLOTTED
+    //[SlotMs, LastId, Cmd, Payload], unwrap and answer node-id slots after the query.
+    uint32_t slot_delay = 0;
+    if(rx->command == BOOT_SLOTTED && rx->data_len >= 3){
+        //Not asked, a later slot may already be the next request.
+        if(node_id > rx->data[1]){
+            return;
+        }
+        slot_delay = node_id * rx->data[0] * 1000uL;
+        rx->command = rx->data[2];
+        rx->data_len -= 3;
+        for(packet_len_t i=0;i<rx->data_len;i++){
+            rx->data[i] = rx->data[i+3];
+        }
+    }
+#endif
+
     const uint8_t cmd = rx->command;
-    const uint8_t datalen = rx->data_len;
+    const packet_len_t datalen = rx->data_len;
 
     uint32_t tx_len=0;
     uint8_t* tx_ptr = (uint8_t*)&tx_data[0];
@@ -125,28 +317,63 @@ void process_packet(Packet_t* rx){
     if(cmd == BOOT_INFO){
         tx_len = 2;
         tx_ptr[0] = BOOTLOADER_MAJOR;
-        tx_ptr[0] = BOOTLOADER_MINOR;
+        tx_ptr[1] = BOOTLOADER_MINOR;
+#if BOOTLOADER_CAPS != 0
+        //Capabilities, Little endian.
+        tx_len = 6;
+        tx_ptr[2] = (uint8_t)(BOOTLOADER_CAPS);
+        tx_ptr[3] = (uint8_t)(BOOTLOADER_CAPS >> 8);
+        tx_ptr[4] = (uint8_t)(BOOTLOADER_CAPS >> 16);
+        tx_ptr[5] = (uint8_t)(BOOTLOADER_CAPS >> 24);
+#endif
     }else if(cmd == BOOT_GET_CHIP){
         //Point tx_ptr to stored chip_name.
         tx_len = sizeof(chip_name);
         tx_ptr = (uint8_t*)&chip_name[0];
-    }else if(cmd == BOOT_ERASE && datalen == 3){
+    }else if(cmd == BOOT_ERASE && BOOT_ERASE_LEN_OK(datalen)){
         //only allow specific firmware.
         if(rx->data[0] != firmware_id){
+            STATS_INC(fw_reject);
             return;
         }
 
-        uint16_t block = *(uint16_t*)(&rx->data[1]);
-        uint32_t adr = 0x08000000 + block*64;
+        //Unaligned, read as bytes.
+        uint32_t block = rx->data[1] | (rx->data[2] << 8);
+
+#if BOOT_FEATURE_RANGE_ERASE
+        //Single block, end is exclusive.
+        uint32_t end = block + 1;
 
-        if(adr < 0xFFFF){
-            flash_erase(adr);
-        }else{
-            //TODO: bulk erase.
+        if(datalen == 5){
+            end = rx->data[3] | (rx->data[4] << 8);
+        }else if(block == 0xFFFF){
+            //Whole application.
+            flash_erase_all();
+            end = 0;
         }
-    }else if(cmd == BOOT_WRITE && datalen == 70){
+
+        //Sector erase where aligned, page erase at the edges.
+        while(block < end){
+            uint32_t adr = 0x08000000 + block*64;
+
+            if((block & 15) == 0 && (end - block) >= 16){
+                flash_erase_sector(adr);
+                block += 16;
+            }else{
+                flash_erase(adr);
+                block++;
+            }
+        }
+#else
+        //Block 0xFFFF is reserved for whole application erase.
+        if(block != 0xFFFF){
+            flash_erase(0x08000000 + block*64);
+        }
+#endif
+    }else if((cmd == BOOT_WRITE && BOOT_WRITE_LEN_OK(datalen)) || BOOT_WRITE_PACKED_OK(cmd, datalen)){
         //only allow specific firmware.
         if(rx->data[0] != firmware_id){
+            STATS_INC(fw_reject);
             return;
         }
 
@@ -158,15 +385,83 @@ void process_packet(Packet_t* rx){
         //
         //Move data to beginning of rx buffer to get 4 byte boundry.
         //flash_write requires this.
-        for(int i=0;i<68;i++){
+        for(int i=0;i<datalen-2;i++){
             rx->data[i] =  rx->data[i+2] + corr;
         }
 
         //Fetch address
         uint32_t adr = *(uint32_t*)(&rx->data[0]);
-        flash_erase(adr);
-        flash_write(adr, &rx->data[4]);
+        uint8_t* page = &rx->data[4];
+
+#if BOOT_FEATURE_PACKED_WRITE
+        //Packed pages, tx_data is free until the response and used as page buffer.
+        if(cmd == BOOT_WRITE_PACKED){
+            unpack_pages(page, datalen - 6, adr, (uint8_t*)&tx_data[0], program_page);
+        }else
+#endif
+        {
+            //One or more consecutive pages.
+            for(int i=6;i<datalen;i+=64){
+                program_page(adr, page);
+                adr += 64;
+                page += 64;
+            }
+        }
         
+#if BOOT_FEATURE_SKIP_SAME
+    }else if(cmd == BOOT_GET_WRITE_STATS){
+        uint16_t* ptr16 = (uint16_t*)&tx_ptr[0];
+
+        //[written, skipped]
+        tx_len = 4;
+        ptr16[0] = write_stats[0];
+        ptr16[1] = write_stats[1];
+
+        //Optional reset.
+        if(datalen == 1 && rx->data[0] == 1){
+            write_stats[0] = 0;
+            write_stats[1] = 0;
+        }
+#endif
+#if BOOT_FEATURE_STATS
+    }else if(cmd == BOOT_GET_STATS){
+        uint16_t* ptr16 = (uint16_t*)&tx_ptr[0];
+        uint16_t* pkt16 = (uint16_t*)&packet_stats;
+        uint16_t* node16 = (uint16_t*)&node_stats;
+
+        //[packet_stats(8), node_stats(8), overruns(2)], Little endian.
+        tx_len = 18;
+        for(int i=0;i<4;i++){
+            ptr16[i] = pkt16[i];
+            ptr16[4+i] = node16[i];
+        }
+        ptr16[8] = uart_overruns;
+
+        //Optional reset.
+        if(datalen == 1 && rx->data[0] == 1){
+            for(int i=0;i<4;i++){
+                pkt16[i] = 0;
+                node16[i] = 0;
+            }
+            uart_overruns = 0;
+        }
+#endif
+#if BOOT_FEATURE_WRITE_MAP
+    }else if(cmd == BOOT_GET_WRITE_MAP){
+        uint32_t* ptr32 = (uint32_t*)&tx_ptr[0];
+        uint32_t* map32 = (uint32_t*)&write_map[0];
+
+        //Copy, the map may be cleared before the response is sent.
+        tx_len = sizeof(write_map);
+        for(uint32_t i=0;i<sizeof(write_map)/4;i++){
+            ptr32[i] = map32[i];
+
+            //Optional reset, start of a new transfer.
+            if(datalen == 1 && rx->data[0] == 1){
+                map32[i] = 0;
+            }
+        }
+#endif
     }else if(cmd == BOOT_GET_ID){
         //set response to UID.
         tx_len = 8;
@@ -175,7 +470,6 @@ void process_packet(Packet_t* rx){
         //Delay according to delay window.
         if(datalen == 1){
             uint32_t slot;
-            volatile uint32_t delay;
 
             //16..288 slots => ~1000ms to 11500ms
             uint32_t slot_count = rx->data[0] + 32;
@@ -196,12 +490,49 @@ void process_packet(Packet_t* rx){
                 }
             }
 
-            //convert slot to time ~40millisec.
-            delay = slot * 40000;
+            //convert slot to time ~40millisec and perform the delay.
+            uart_delay(slot * 40000);
+        }
+#if BOOT_FEATURE_SET_BAUD
+    }else if(cmd == BOOT_SET_BAUD && datalen == 2){
+        uint16_t brr = *(uint16_t*)(&rx->data[0]);
+
+        //Same baudrate is a confirm, already handled in main loop.
+        //Otherwise switch and fallback to default if the host never confirm.
+        //A BRR below the minimum would leave the node deaf, ignore it.
+        if(brr >= UART_BRR_MIN && brr != uart_get_brr()){
+            baud_timeout = BOOT_BAUD_CONFIRM_LOOPS;
+            uart_set_brr(brr);
+        }
+
+        //No response, host is still on the old baudrate.
+        return;
+#endif
+#if BOOT_FEATURE_UID_SEARCH
+    }else if(cmd == BOOT_SEARCH_UID && datalen == 16){
+        const uint32_t* uid32 = (const uint32_t*)&chip_id[0];
+        const uint32_t* mask32 = (const uint32_t*)&rx->data[0];
+        const uint32_t* value32 = (const uint32_t*)&rx->data[8];
+
+        //Only answer if the masked UID match.
+        for(int i=0;i<2;i++){
+            if((uid32[i] ^ value32[i]) & mask32[i]){
+                return;
+            }
+        }
 
-            //perform the delay.
-            while(delay--){}
+        //UID, node-id, firmware-id and capabilities in one response.
+        tx_len = 14;
+        for(int i=0;i<8;i++){
+            tx_ptr[i] = chip_id[i];
         }
+        tx_ptr[8] = node_id;
+        tx_ptr[9] = firmware_id;
+        tx_ptr[10] = (uint8_t)(BOOTLOADER_CAPS);
+        tx_ptr[11] = (uint8_t)(BOOTLOADER_CAPS >> 8);
+        tx_ptr[12] = (uint8_t)(BOOTLOADER_CAPS >> 16);
+        tx_ptr[13] = (uint8_t)(BOOTLOADER_CAPS >> 24);
+#endif
     }else if(cmd == BOOT_SILENT){
         stay_silent=1;
     }else if(cmd == BOOT_UNSILENT){
@@ -209,19 +540,73 @@ void process_packet(Packet_t* rx){
     }else if(cmd == BOOT_GO){
         //handled after transmitt is done.
         boot_timeout=1;
-    }else if(cmd == BOOT_GET_CRC32 && datalen == 8){
+    }else if(cmd == BOOT_GET_CRC32 && BOOT_CRC32_LEN_OK(datalen)){
         uint32_t* ptr32 = (uint32_t*)&tx_ptr[0];
         uint32_t crc;
 
         uint32_t adr = *(uint32_t*)&rx->data[0];
         uint32_t cnt = *(uint32_t*)&rx->data[4];
 
+#if BOOT_FEATURE_QUIET_VERIFY
+        //Quiet verify of another firmware.
+        if(datalen == 13 && rx->data[12] != firmware_id){
+            return;
+        }
+#endif
+
         //Set response to CRC32.
         crc = crc32_calc((const uint8_t*)adr, cnt);
 
+#if BOOT_FEATURE_QUIET_VERIFY
+        //Quiet verify, silent when the flash holds the expected data.
+        if(datalen == 13 && crc == *(uint32_t*)&rx->data[8]){
+            return;
+        }
+#endif
+
         //Data response.
         tx_len=4;
         ptr32[0] = crc;
+#if BOOT_FEATURE_CRC_MAP
+    }else if(cmd == BOOT_GET_CRC_MAP && datalen == 6){
+        uint32_t* ptr32 = (uint32_t*)&tx_ptr[0];
+
+        uint32_t adr = *(uint32_t*)&rx->data[0];
+        uint32_t size = 1uL << rx->data[4];
+        uint32_t cnt = rx->data[5];
+
+        //Response must fit in tx_data.
+        if(cnt > sizeof(tx_data) / 4){
+            return;
+        }
+
+        //One CRC32 per block.
+        tx_len = cnt * 4;
+        while(cnt--){
+            *ptr32++ = crc32_calc((const uint8_t*)adr, size);
+            adr += size;
+        }
+#endif
+#if BOOT_FEATURE_WRITE_CRC
+    }else if(cmd == BOOT_GET_WRITE_CRC){
+        uint32_t* ptr32 = (uint32_t*)&tx_ptr[0];
+        uint32_t* pages32 = (uint32_t*)&write_crc_pages[0];
+
+        //[Pages(16), CRC32 of the 16 sector states]
+        tx_len = 20;
+        for(int i=0;i<4;i++){
+            ptr32[i] = pages32[i];
+        }
+        ptr32[4] = crc32_calc((const uint8_t*)&write_crc[0], sizeof(write_crc));
+
+        //Optional reset, start of a new transfer.
+        if(datalen == 1 && rx->data[0] == 1){
+            for(int i=0;i<16;i++){
+                write_crc[i] = 0;
+                write_crc_pages[i] = 0;
+            }
+        }
+#endif
     }else if(cmd == BOOT_GET_NODE_ID){
         tx_len=2;
         tx_ptr[0] = node_id;
@@ -247,6 +632,11 @@ void process_packet(Packet_t* rx){
         return;
     }
 
+#if BOOT_FEATURE_SLOTTED
+    //Wait for our slot, the query took the same time on every node.
+    uart_delay(slot_delay);
+#endif
+
     //Build response
     uint8_t* tx_buffer_ptr = (uint8_t*)&tx_buffer[0];
     uint32_t packet_len = packet_serialize(tx_buffer_ptr, node_id, rx->command, tx_ptr, tx_len);
@@ -281,6 +671,16 @@ void initialize(void){
     GPIOD->CFGLR = 0x4F444484;
 
     uart_init();
+
+#if BOOT_CRC32_ENGINE == CRC32_ENGINE_BYTE_RAM
+    //Before the first frame, the parser runs the CRC per byte.
+    crc32_table_init();
+#endif
+
+#if BOOT_FEATURE_STATS
+    //SysTick HCLK/8 => 1us per count, used for busy time.
+    SysTick->CTLR = 1;
+#endif
 }
 
 /**
@@ -290,6 +690,11 @@ void deinitilize(void){
     //Restore GPIOD config
     GPIOD->CFGLR = 0x44444484;
 
+#if BOOT_FEATURE_STATS
+    SysTick->CTLR = 0;
+    SysTick->CNT = 0;
+#endif
+
     uart_deinit();
 }
 
@@ -299,12 +704,22 @@ void deinitilize(void){
  */
 int main(){
     initialize();
-    boot_timeout = 1<<20;       //~4.5 seconds
+#if BOOT_FEATURE_APP_CHECK
+    boot_timeout = app_boot_wait();
+#else
+    boot_timeout = BOOT_WAIT_LOOPS;
+#endif
+#if BOOT_FEATURE_WARM_ENTRY
+    //Entered by the application, the host is already waiting.
+    if(boot_warm == BOOT_WARM_MAGIC){
+        boot_timeout = 0;
+    }
+#endif
     
 
     while (1){
         //Must be run first, process_packet may change boot_timeout to exist bootloader.
-        if(get_packet_total_sync_count() > 10){
+        if(packet.rx.sync_total > 10){
             boot_timeout = 0;
         }
         
@@ -313,9 +728,30 @@ int main(){
             uint8_t rx = uart_read();
 
             if(Packet_Update_Rx(rx, &packet)){
+#if BOOT_FEATURE_SET_BAUD
+                //Any valid packet confirm the current baudrate.
+                baud_timeout = 0;
+#endif
+#if BOOT_FEATURE_STATS
+                uint32_t start = SysTick->CNT;
                 process_packet(&packet);
+                node_stats.busy_us += SysTick->CNT - start;
+#else
+                process_packet(&packet);
+#endif
+            }
+        }
+
+#if BOOT_FEATURE_SET_BAUD
+        //Host did not confirm the new baudrate, go back to default.
+        if(baud_timeout > 0){
+            baud_timeout--;
+
+            if(baud_timeout == 0){
+                uart_set_brr(UART_BRR_DEFAULT);
             }
         }
+#endif
 
         //check if we should leave the bootloader.
         //This must be run last in main loop due to process_packet can set
@@ -0,0 +1,110 @@
+#include <unity.h>
+#include <stdio.h>
+#include <string.h>
+#include <ch32v00x.h>
+#include "crc32.h"
+
+// Requires -DCRC32_ALL_ENGINES (test_env build_flags).
+
+typedef void (*crc32_engine_t)(uint32_t *state, const uint8_t *data, size_t len);
+
+static const struct {
+    const char *name;
+    crc32_engine_t update;
+} engines[] = {
+    {"bitwise",          crc32_update_bitwise},
+    {"nibble",           crc32_update_nibble},
+    {"nibble_unrolled",  crc32_update_nibble_unrolled},
+    {"byte_ram",         crc32_update_byte_ram},
+};
+#define ENGINE_COUNT (sizeof(engines) / sizeof(engines[0]))
+
+// Application flash, as BOOT_GET_CRC32 on a 16KB image.
+#define IMAGE_ADR   0x08000000
+#define IMAGE_SIZE  16384
+
+static uint8_t buffer[80] __attribute__((aligned(4)));
+
+void setUp(void) {
+    for (uint32_t i = 0; i < sizeof(buffer); i++) {
+        buffer[i] = (uint8_t)(i * 37u + 11u);
+    }
+}
+
+void tearDown(void) {}
+
+static uint32_t engine_crc(crc32_engine_t update, const uint8_t *data, size_t len) {
+    uint32_t state;
+    crc32_init(&state);
+    update(&state, data, len);
+    return crc32_finalize(&state);
+}
+
+/**
+ * Every engine gives the standard check value.
+ */
+void test_crc32_engines_check_value(void) {
+    const uint8_t data[] = "123456789";
+
+    for (uint32_t e = 0; e < ENGINE_COUNT; e++) {
+        TEST_ASSERT_EQUAL_HEX32_MESSAGE(0xCBF43926, engine_crc(engines[e].update, data, 9), engines[e].name);
+    }
+}
+
+/**
+ * Every engine match the bitwise reference for all lengths and alignments.
+ */
+void test_crc32_engines_match(void) {
+    for (uint32_t offset = 0; offset < 4; offset++) {
+        for (uint32_t len = 0; len <= sizeof(buffer) - 4; len++) {
+            uint32_t expected = engine_crc(crc32_update_bitwise, &buffer[offset], len);
+
+            for (uint32_t e = 1; e < ENGINE_COUNT; e++) {
+                TEST_ASSERT_EQUAL_HEX32_MESSAGE(expected, engine_crc(engines[e].update, &buffer[offset], len), engines[e].name);
+            }
+        }
+    }
+}
+
+/**
+ * Cycles per byte of each engine over the 16KB application flash.
+ * Flash size of each engine is reported by bench/crc32_size.py.
+ */
+void test_crc32_engines_report(void) {
+    char line[64];
+    uint32_t expected = engine_crc(crc32_update_bitwise, (const uint8_t*)IMAGE_ADR, IMAGE_SIZE);
+
+    for (uint32_t e = 0; e < ENGINE_COUNT; e++) {
+        // SysTick on HCLK, counts CPU cycles.
+        SysTick->CTLR = 0;
+        SysTick->CNT = 0;
+        SysTick->CTLR = (1 << 2) | 1;
+
+        uint32_t crc = engine_crc(engines[e].update, (const uint8_t*)IMAGE_ADR, IMAGE_SIZE);
+        uint32_t cycles = SysTick->CNT;
+        SysTick->CTLR = 0;
+
+        TEST_ASSERT_EQUAL_HEX32_MESSAGE(expected, crc, engines[e].name);
+
+        uint32_t per_byte_x100 = (uint32_t)((uint64_t)cycles * 100 / IMAGE_SIZE);
+        snprintf(line, sizeof(line), "%-16s %3lu.%02lu cycles/byte, %lu cycles/16KB",
+            engines[e].name,
+            (unsigned long)(per_byte_x100 / 100), (unsigned long)(per_byte_x100 % 100),
+            (unsigned long)cycles);
+        TEST_MESSAGE(line);
+    }
+}
+
+int main(void) {
+    crc32_table_init();
+    UNITY_BEGIN();
+    RUN_TEST(test_crc32_engines_check_value);
+    RUN_TEST(test_crc32_engines_match);
+    RUN_TEST(test_crc32_engines_report);
+    UNITY_END();
+
+    while(1)
+    {
+
+    }
+}
@@ -115,12 +115,114 @@ void test_packet_resync(void) {
     TEST_ASSERT_EQUAL_UINT8(0x44, rx_pkt.data[0]);
 }
 
+/**
+ * Build a broadcast request, header flags 0x08 = burst.
+ */
+static uint32_t build_request(uint8_t* buf, uint8_t preamble, uint8_t flags, uint8_t cmd, const uint8_t* data, uint8_t len) {
+    uint32_t i = 0;
+    while (preamble--) {
+        buf[i++] = PREAMBLE_BYTE;
+    }
+    uint32_t start = i;
+    buf[i++] = 0x80 | flags;
+    buf[i++] = 0xFF;
+    buf[i++] = cmd;
+    buf[i++] = len;
+    memcpy(&buf[i], data, len);
+    i += len;
+
+    uint32_t crc = crc32_calc(&buf[start], i - start);
+    memcpy(&buf[i], &crc, 4);
+    return i + 4;
+}
+
+/**
+ * Test 5: Independent parsers
+ * The receive state is in the packet, two streams fed byte by byte in turn do not mix.
+ */
+void test_packet_two_parsers(void) {
+    static Packet_t other;
+    const uint8_t payload[] = {0x11, 0x22, 0x33};
+    uint8_t* stream = &buffer[256];
+    uint32_t done = 0;
+
+    memset(&other, 0, sizeof(other));
+    uint32_t len = build_request(buffer, 5, 0x00, 0x41, payload, 3);
+    build_request(stream, 5, 0x00, 0x42, payload, 2);
+
+    for (uint32_t i = 0; i < len; i++) {
+        done += Packet_Update_Rx(buffer[i], &rx_pkt);
+        done += Packet_Update_Rx(stream[i], &other) << 1;
+    }
+
+    //Second stream is one byte shorter and completes first.
+    TEST_ASSERT_EQUAL_UINT32(3, done);
+    TEST_ASSERT_EQUAL_HEX8(0x41, rx_pkt.command);
+    TEST_ASSERT_EQUAL_UINT8(3, rx_pkt.data_len);
+    TEST_ASSERT_EQUAL_HEX8(0x42, other.command);
+    TEST_ASSERT_EQUAL_UINT8(2, other.data_len);
+    TEST_ASSERT_EQUAL_UINT32(5, other.rx.sync_total);
+}
+
+#if BOOT_FEATURE_BURST
+
+/**
+ * Feed bytes, returns number of valid requests.
+ */
+static uint32_t feed(const uint8_t* buf, uint32_t len) {
+    uint32_t count = 0;
+    for (uint32_t i = 0; i < len; i++) {
+        count += Packet_Update_Rx(buf[i], &rx_pkt);
+    }
+    return count;
+}
+
+/**
+ * Test 6: Burst
+ * Frames after a burst frame are received without preamble, until a frame without the flag.
+ */
+void test_packet_burst(void) {
+    const uint8_t payload[] = {0x11, 0x22};
+    uint32_t len = 0;
+
+    len += build_request(&buffer[len], 5, 0x08, 0x31, payload, 2);
+    len += build_request(&buffer[len], 0, 0x08, 0x32, payload, 2);
+    len += build_request(&buffer[len], 0, 0x00, 0x33, payload, 2);
+    len += build_request(&buffer[len], 0, 0x00, 0x34, payload, 2);
+
+    TEST_ASSERT_EQUAL_UINT32(3, feed(buffer, len));
+    TEST_ASSERT_EQUAL_HEX8(0x33, rx_pkt.command);
+}
+
+/**
+ * Test 7: Burst resync
+ * A CRC error breaks the burst, the next preamble starts over.
+ */
+void test_packet_burst_resync(void) {
+    const uint8_t payload[] = {0x11, 0x22};
+    uint32_t len = 0;
+
+    len += build_request(&buffer[len], 5, 0x08, 0x31, payload, 2);
+    buffer[len - 1] ^= 0xFF;
+    len += build_request(&buffer[len], 0, 0x08, 0x32, payload, 2);
+    len += build_request(&buffer[len], 5, 0x00, 0x33, payload, 2);
+
+    TEST_ASSERT_EQUAL_UINT32(1, feed(buffer, len));
+    TEST_ASSERT_EQUAL_HEX8(0x33, rx_pkt.command);
+}
+#endif
+
 int main(void) {
     UNITY_BEGIN();
     RUN_TEST(test_packet_serialization_basic);
     RUN_TEST(test_packet_round_trip);
     RUN_TEST(test_packet_invalid_crc);
     RUN_TEST(test_packet_resync);
+    RUN_TEST(test_packet_two_parsers);
+#if BOOT_FEATURE_BURST
+    RUN_TEST(test_packet_burst);
+    RUN_TEST(test_packet_burst_resync);
+#endif
     return UNITY_END();
 }
 
@@ -0,0 +1,117 @@
+#include <unity.h>
+#include <string.h>
+#include "unpack.h"
+
+// Decoded pages, the decoder reads earlier pages back from here.
+static uint8_t out[256] __attribute__((aligned(4)));
+static uint8_t page[64] __attribute__((aligned(4)));
+static uint32_t emitted;
+
+static void emit(uint32_t adr, uint8_t* data) {
+    memcpy((uint8_t*)adr, data, 64);
+    emitted++;
+}
+
+void setUp(void) {
+    memset(out, 0, sizeof(out));
+    emitted = 0;
+}
+
+void tearDown(void) {}
+
+/**
+ * Literal runs only, split over two tokens.
+ */
+void test_unpack_literals(void) {
+    uint8_t stream[2 + 64];
+    stream[0] = 0x1F;               // 32 literals
+    stream[33] = 0x1F;              // 32 literals
+    for (int i = 0; i < 32; i++) {
+        stream[1 + i] = i;
+        stream[34 + i] = 32 + i;
+    }
+
+    uint32_t n = unpack_pages(stream, sizeof(stream), (uint32_t)out, page, emit);
+
+    TEST_ASSERT_EQUAL_UINT32(64, n);
+    TEST_ASSERT_EQUAL_UINT32(1, emitted);
+    for (int i = 0; i < 64; i++) {
+        TEST_ASSERT_EQUAL_HEX8(i, out[i]);
+    }
+}
+
+/**
+ * Erased fill, one literal and a distance 1 match repeating it.
+ */
+void test_unpack_fill(void) {
+    // 0xFF, then 63 (60 + 3) copies of the previous byte.
+    const uint8_t stream[] = {0x00, 0xFF, 0x80 | 60, 0x00};
+
+    uint32_t n = unpack_pages(stream, sizeof(stream), (uint32_t)out, page, emit);
+
+    TEST_ASSERT_EQUAL_UINT32(64, n);
+    TEST_ASSERT_EQUAL_UINT32(1, emitted);
+    for (int i = 0; i < 64; i++) {
+        TEST_ASSERT_EQUAL_HEX8(0xFF, out[i]);
+    }
+}
+
+/**
+ * Match in the second page with data from the already emitted first page.
+ */
+void test_unpack_match_previous_page(void) {
+    uint8_t stream[1 + 64 + 3];
+    stream[0] = 0x3F;               // 64 literals
+    for (int i = 0; i < 64; i++) {
+        stream[1 + i] = 0xA0 ^ i;
+    }
+    // 64 (61 + 3) bytes from distance 64, two byte distance.
+    stream[65] = 0xC0 | 61;
+    stream[66] = 63;
+    stream[67] = 0;
+
+    uint32_t n = unpack_pages(stream, sizeof(stream), (uint32_t)out, page, emit);
+
+    TEST_ASSERT_EQUAL_UINT32(128, n);
+    TEST_ASSERT_EQUAL_UINT32(2, emitted);
+    TEST_ASSERT_EQUAL_MEMORY(&out[0], &out[64], 64);
+}
+
+/**
+ * A trailing partial page is not emitted.
+ */
+void test_unpack_partial_page(void) {
+    const uint8_t stream[] = {0x00, 0x55, 0x80 | 7, 0x00};
+
+    uint32_t n = unpack_pages(stream, sizeof(stream), (uint32_t)out, page, emit);
+
+    TEST_ASSERT_EQUAL_UINT32(11, n);
+    TEST_ASSERT_EQUAL_UINT32(0, emitted);
+}
+
+/**
+ * Distance before the start of the stream and truncated literals are rejected.
+ */
+void test_unpack_malformed(void) {
+    const uint8_t far[] = {0x00, 0x11, 0x80, 0x01};
+    const uint8_t short_literal[] = {0x05, 0x11, 0x22};
+    //Match token without its distance byte(s), nothing past the stream is read.
+    const uint8_t short_match[] = {0x00, 0x11, 0x80};
+    const uint8_t short_match_far[] = {0x00, 0x11, 0xC0, 0x00};
+
+    TEST_ASSERT_EQUAL_UINT32(0, unpack_pages(far, sizeof(far), (uint32_t)out, page, emit));
+    TEST_ASSERT_EQUAL_UINT32(0, unpack_pages(short_literal, sizeof(short_literal), (uint32_t)out, page, emit));
+    TEST_ASSERT_EQUAL_UINT32(0, unpack_pages(short_match, sizeof(short_match), (uint32_t)out, page, emit));
+    TEST_ASSERT_EQUAL_UINT32(0, unpack_pages(short_match_far, sizeof(short_match_far), (uint32_t)out, page, emit));
+    TEST_ASSERT_EQUAL_UINT32(0, emitted);
+}
+
+int main(void) {
+    UNITY_BEGIN();
+    RUN_TEST(test_unpack_literals);
+    RUN_TEST(test_unpack_fill);
+    RUN_TEST(test_unpack_match_previous_page);
+    RUN_TEST(test_unpack_partial_page);
+    RUN_TEST(test_unpack_malformed);
+    return UNITY_END();
+}
@@ -5,6 +5,7 @@ import binascii
 import threading
 import queue
 import sys
+import math
 import argparse
 
 # Protocol Constants
@@ -14,47 +15,551 @@ PREAMBLE_TX_COUNT = 12
 
 HDR_MASK_BASE = 0x80      
 HDR_FLAG_64BIT = 0x02    
+HDR_FLAG_EXT_LEN = 0x04
+HDR_FLAG_BURST = 0x08
 BROADCAST_ID = 0xFF
 
 BOOT_GET_INFO = 0x01
 BOOT_GET_CHIP_ID = 0x02
+BOOT_GET_STATS = 0x03
 
 # firmware update commands
 BOOT_WRITE = 0x31
+BOOT_WRITE_PACKED = 0x32
 BOOT_ERASE = 0x44
+BOOT_GET_WRITE_STATS = 0x35
+BOOT_GET_WRITE_MAP = 0x36
 BOOT_GET_CRC = 0xA1
+BOOT_GET_CRC_MAP = 0xA2
+BOOT_GET_WRITE_CRC = 0xA3
 BOOT_GO = 0x21
 
 #search commands
 BOOT_GET_ID = 0x11
 BOOT_SILENCE = 0x12
 BOOT_UNSILENCE = 0x13
+BOOT_SEARCH_UID = 0x14
+
+#bus commands
+BOOT_SET_BAUD = 0x15
+BOOT_SLOTTED = 0x16
 
 #Node info commands
 BOOT_GET_NODE_INFO = 0xC1
 BOOT_SET_NODE_INFO = 0xC2
 
+# Capability bits from BOOT_GET_INFO
+BOOT_CAP_SET_BAUD = 0x00000001
+BOOT_CAP_EXT_FRAME = 0x00000002
+BOOT_CAP_CRC_MAP = 0x00000004
+BOOT_CAP_UID_SEARCH = 0x00000008
+BOOT_CAP_RANGE_ERASE = 0x00000010
+BOOT_CAP_SKIP_SAME = 0x00000020
+BOOT_CAP_WRITE_MAP = 0x00000040
+BOOT_CAP_STATS = 0x00000080
+BOOT_CAP_UART_DMA = 0x00000100
+BOOT_CAP_PACKED_WRITE = 0x00000200
+BOOT_CAP_WRITE_CRC = 0x00000400
+BOOT_CAP_BURST = 0x00000800
+BOOT_CAP_SLOTTED = 0x00001000
+BOOT_CAP_QUIET_VERIFY = 0x00002000
+BOOT_CAP_IAP_PACKET = 0x00004000
+BOOT_CAP_APP_CHECK = 0x00008000
+BOOT_CAP_WARM_ENTRY = 0x00010000
+BOOT_CAP_ALL = 0x0001FFFF
+
+# BOOT_GET_STATS response fields, all Little endian.
+STATS_FIELDS = ('rx_ok', 'crc_errors', 'wrong_type', 'too_long',
+                'addr_mismatch', 'fw_reject', 'busy_us', 'overruns')
+STATS_FORMAT = '<HHHHHHIH'
+
+# Max entries in one BOOT_GET_CRC_MAP response.
+CRC_MAP_MAX_COUNT = 16
+
+# Pages per BOOT_WRITE with extended frames (1KB sector).
+EXT_WRITE_PAGES = 16
+
+# Approximate time for a node to erase and program one page.
+PAGE_PROGRAM_TIME = 0.006
+
+
+# Bytes a node with DMA RX buffers while flash is busy, 3/4 of the default ring.
+DMA_RX_BYTES = 192
+
+# Approximate erase time for a 64 byte page and a 1KB sector.
+PAGE_ERASE_TIME = 0.003
+SECTOR_ERASE_TIME = 0.006
+
+# Rebroadcast rounds for blocks missed by any node.
+REPAIR_ROUNDS = 3
+
+# Single BOOT_GET_WRITE_MAP retries before a node is reported unreachable.
+WRITE_MAP_RETRIES = 2
+
+# Pages per BOOT_WRITE_PACKED (1KB sector) and max packed stream per frame.
+PACKED_WRITE_PAGES = 16
+PACKED_STREAM_MAX = 249
+EXT_PACKED_STREAM_MAX = 1024
+
+# Burst frames sent without preamble before the next preamble, a node that
+# lost a frame waits for it.
+BURST_MAX_FRAMES = 16
+
+# BOOT_ERASE block index that erases the whole application.
+ERASE_ALL_BLOCK = 0xFFFF
+
+# Reply allowance before any node turnaround is measured, the minimum
+# (host scheduling) and margin over the slowest measured turnaround.
+# The measured turnaround includes the USB adapter latency.
+TURNAROUND_DEFAULT = 0.5
+TURNAROUND_MIN = 0.01
+TURNAROUND_MARGIN = 2.0
+
+# Node CRC32 time per byte of flash, slowest engine at 8 MHz.
+CRC_TIME_PER_BYTE = 0.000006
+
+# Approximate time for a node to rewrite the option bytes.
+OPTION_WRITE_TIME = 0.05
+
+# BOOT_GET_ID slot length on the node (~40 ms) with clock tolerance.
+SEARCH_SLOT_TIME = 0.05
+
+# Gap between the replies of a BOOT_SLOTTED query (turnaround jitter), and the
+# clock tolerance of the nodes, each node times its own slot.
+SLOT_GUARD = 0.005
+SLOT_CLOCK_TOLERANCE = 0.02
+SLOT_MAX_MS = 255
+
+# Response frame without data: preamble(5), header, node id, command, length, CRC(4).
+RESPONSE_OVERHEAD = 5 + 1 + 1 + 1 + 1 + 4
+
+# Node turnaround assumed by --dry-run.
+ESTIMATE_TURNAROUND = 0.005
+
+# Node clock, used to calculate baudrate register.
+NODE_CLOCK_HZ = 8000000
+DEFAULT_BAUD = 9600
+# Lowest BRR the nodes accept (500000 bps), BRR is 16 bits.
+BRR_MIN = 16
+BRR_MAX = 0xFFFF
+
+# Application flash, linker scripts place it at 0 or at the flash address.
+FLASH_BASE = 0x08000000
+FLASH_SIZE = 16 * 1024
+
+# Erased flash does not read as 0xFF on CH32V003 (FLASH_ERASED_WORD).
+ERASED_PAGE = struct.pack('<I', 0xE339E339) * 16
+
+# Application length and CRC32 in the last 8 bytes of flash (BOOT_CAP_APP_CHECK),
+# the page is not available to the application.
+TRAILER_PAGE = FLASH_SIZE // 64 - 1
+
+
+def read_hex(text):
+    """Data records of an Intel HEX file as (address, bytes)."""
+    segments = []
+    upper = 0
+    for number, line in enumerate(text.splitlines(), 1):
+        line = line.strip()
+        if not line:
+            continue
+        try:
+            record = bytes.fromhex(line[1:]) if line[0] == ':' else b''
+        except ValueError:
+            record = b''
+        if len(record) < 5 or len(record) != record[0] + 5 or sum(record) & 0xFF:
+            raise ValueError(f"line {number}: invalid Intel HEX record")
+
+        offset, kind, payload = (record[1] << 8) | record[2], record[3], record[4:-1]
+        if kind == 0x00:
+            segments.append((upper + offset, payload))
+        elif kind == 0x01:
+            break
+        elif kind == 0x02:
+            upper = ((payload[0] << 8) | payload[1]) << 4
+        elif kind == 0x04:
+            upper = ((payload[0] << 8) | payload[1]) << 16
+        # 0x03 and 0x05 are start addresses, not flash content.
+    return segments
+
+
+def read_elf(blob):
+    """Loadable segments of a 32bit little endian ELF as (load address, bytes)."""
+    if blob[4:6] != b'\x01\x01':
+        raise ValueError("only 32bit little endian ELF files are supported")
+    phoff, = struct.unpack_from('<I', blob, 28)
+    phentsize, phnum = struct.unpack_from('<HH', blob, 42)
+
+    segments = []
+    for i in range(phnum):
+        kind, offset, _, paddr, filesz = struct.unpack_from('<IIIII', blob, phoff + i * phentsize)
+        # PT_LOAD, initialized data is stored at its load address in flash.
+        if kind == 1 and filesz:
+            segments.append((paddr, blob[offset:offset + filesz]))
+    return segments
+
+
+def load_image(path):
+    """
+    Firmware from a raw binary, Intel HEX or ELF file. Returns (data, blank),
+    data from the start of flash and the pages without any content. Blank
+    pages are erased instead of written and hold the erased pattern in data,
+    the CRC32 of data matches the flash. A raw binary has no blank pages.
+    """
+    with open(path, 'rb') as f:
+        blob = f.read()
+    if blob[:4] == b'\x7fELF':
+        segments = read_elf(blob)
+    elif path.lower().endswith(('.hex', '.ihx', '.ihex')):
+        segments = read_hex(blob.decode('ascii'))
+    else:
+        return blob, set()
+
+    image = bytearray()
+    used = set()
+    for address, payload in segments:
+        offset = address - FLASH_BASE if address >= FLASH_BASE else address
+        end = offset + len(payload)
+        if offset < 0 or end > FLASH_SIZE:
+            raise ValueError(f"0x{address:08X}-0x{address + len(payload):08X} is outside the application flash")
+        if end > len(image):
+            image += b'\xff' * (end - len(image))
+        image[offset:end] = payload
+        used.update(range(offset // 64, (end + 63) // 64))
+
+    # Whole pages, the rest of a page with content is programmed as 0xFF.
+    pages = (len(image) + 63) // 64
+    image += b'\xff' * (pages * 64 - len(image))
+    blank = set(range(pages)) - used
+    for page in blank:
+        image[page * 64:(page + 1) * 64] = ERASED_PAGE
+    return bytes(image), blank
+
+
+def pack_pages(data):
+    """
+    Pack pages for BOOT_WRITE_PACKED, greedy LZ decoded by unpack_pages() in the
+    bootloader. Tokens: 0x00-0x7F literals (n + 1), 0x80-0xBF match (n + 3) with
+    one distance byte, 0xC0-0xFF match with two distance bytes, distance - 1.
+    """
+    out = bytearray()
+    literals = bytearray()
+    chains = {}
+    size = len(data)
+
+    def flush_literals():
+        for i in range(0, len(literals), 128):
+            chunk = literals[i:i + 128]
+            out.append(len(chunk) - 1)
+            out.extend(chunk)
+        literals.clear()
+
+    pos = 0
+    while pos < size:
+        best_len = 0
+        best_dist = 0
+        limit = min(66, size - pos)
+        if limit >= 3:
+            # Most recent candidates first, they have the short distances.
+            for cand in reversed(chains.get(data[pos:pos + 3], ())):
+                length = 3
+                while length < limit and data[cand + length] == data[pos + length]:
+                    length += 1
+                if length > best_len:
+                    best_len, best_dist = length, pos - cand
+                    if length == limit:
+                        break
+
+        # A far match costs 3 bytes, only shorter than literals from 4 bytes.
+        if best_len >= 4 or (best_len == 3 and best_dist <= 256):
+            flush_literals()
+            dist = best_dist - 1
+            if dist < 256:
+                out += bytes([0x80 | (best_len - 3), dist])
+            else:
+                out += bytes([0xC0 | (best_len - 3), dist & 0xFF, dist >> 8])
+            step = best_len
+        else:
+            literals.append(data[pos])
+            step = 1
+
+        for p in range(pos, min(pos + step, size - 2)):
+            chain = chains.setdefault(data[p:p + 3], [])
+            chain.append(p)
+            if len(chain) > 32:
+                del chain[0]
+        pos += step
+
+    flush_literals()
+    return bytes(out)
+
+
+class FrameParser:
+    """
+    Incremental RESPONSE frame parser, same state machine as Packet_Update_Rx()
+    in the firmware. Bytes are handled once, no rescans or buffer copies.
+    """
+    IDLE, ADDR, CMD, LEN, LEN_HI, DATA, CRC, NEXT = range(8)
+
+    # Header(1) + Address(8) + Command(1) + Length(2) + Data(65535) + CRC(4)
+    MAX_FRAME = 1 + 8 + 1 + 2 + 0xFFFF + 4
+
+    def __init__(self):
+        self.state = self.IDLE
+        self.sync_count = 0
+        self.buf = bytearray(self.MAX_FRAME)
+        self.pos = 0
+        self.remaining = 0
+        self.addr_len = 1
+        self.len_size = 1
+        self.data_len = 0
+
+        # CRC errors and unexpected bytes between frames, i.e. collisions.
+        self.errors = 0
+
+    def feed(self, data):
+        """Feed received bytes, returns a list of complete valid frames."""
+        frames = []
+        buf = self.buf
+
+        for byte in data:
+            # Resync on preamble + header, also in the middle of a frame.
+            # A burst frame is followed directly by the next header.
+            if byte == PREAMBLE_BYTE:
+                self.sync_count += 1
+            else:
+                if (self.sync_count >= PREAMBLE_RX_COUNT or self.state == self.NEXT) and (byte & 0xF0) == HDR_MASK_BASE:
+                    self.state = self.ADDR
+                    self.addr_len = 8 if byte & HDR_FLAG_64BIT else 1
+                    self.len_size = 2 if byte & HDR_FLAG_EXT_LEN else 1
+                    self.remaining = self.addr_len
+                    buf[0] = byte
+                    self.pos = 1
+                    self.sync_count = 0
+                    continue
+                self.sync_count = 0
+
+            state = self.state
+            if state == self.NEXT:
+                state = self.state = self.IDLE
+            if state == self.IDLE:
+                if byte != PREAMBLE_BYTE:
+                    self.errors += 1
+                continue
+
+            buf[self.pos] = byte
+            self.pos += 1
+
+            if state == self.ADDR:
+                self.remaining -= 1
+                if self.remaining == 0:
+                    self.state = self.CMD
+            elif state == self.CMD:
+                self.state = self.LEN
+            elif state == self.LEN:
+                self.data_len = byte
+                if self.len_size == 2:
+                    self.state = self.LEN_HI
+                else:
+                    self._start_data()
+            elif state == self.LEN_HI:
+                self.data_len |= byte << 8
+                self._start_data()
+            elif state == self.DATA:
+                self.remaining -= 1
+                if self.remaining == 0:
+                    self.state = self.CRC
+                    self.remaining = 4
+            elif state == self.CRC:
+                self.remaining -= 1
+                if self.remaining == 0:
+                    self.state = self.IDLE
+                    frame = self._finish()
+                    if frame:
+                        frames.append(frame)
+
+        return frames
+
+    def _start_data(self):
+        self.remaining = self.data_len
+        self.state = self.DATA if self.data_len else self.CRC
+        if not self.data_len:
+            self.remaining = 4
+
+    def _finish(self):
+        end = self.pos
+        view = memoryview(self.buf)
+        rx_crc = struct.unpack_from('<I', self.buf, end - 4)[0]
+        if rx_crc != binascii.crc32(view[:end - 4]) & 0xFFFFFFFF:
+            # Most likely two nodes answering at the same time.
+            self.errors += 1
+            return None
+
+        if self.buf[0] & HDR_FLAG_BURST:
+            self.state = self.NEXT
+
+        # Only responses, our own requests are echoed on the half-duplex bus.
+        if not (self.buf[0] & CH32V003Bootloader.HDR_MASK_TYPE):
+            return None
+
+        packet_data = bytes(view[:end])
+        addr_len = self.addr_len
+        data_start = 1 + addr_len + 1 + self.len_size
+        addr_raw = packet_data[1 : 1 + addr_len]
+        return {
+            'node_id': addr_raw[0] if addr_len == 1 else None,
+            'uid': addr_raw.hex().upper() if addr_len == 8 else None,
+            'cmd': packet_data[1 + addr_len],
+            'data': packet_data[data_start : data_start + self.data_len],
+            'raw': packet_data
+        }
+
+
+class BusTiming:
+    """
+    Air time of frames on the bus and the measured turnaround of each node.
+    Response timeouts and gaps are derived from these instead of fixed
+    worst case values, a missing node only costs a short wait.
+    """
+    def __init__(self, baud):
+        self.baud = baud
+        self.turnaround = {}
+
+    def byte_time(self):
+        # Start bit, 8 data bits and 2 stop bits.
+        return 11 / self.baud
+
+    def request_time(self, data_len, addr_len=1, preamble=PREAMBLE_TX_COUNT):
+        """Air time of a request frame."""
+        length_size = 2 if data_len > 255 else 1
+        return (preamble + 1 + addr_len + 1 + length_size + data_len + 4) * self.byte_time()
+
+    def response_time(self, data_len):
+        """Air time of a response frame."""
+        return (RESPONSE_OVERHEAD + data_len) * self.byte_time()
+
+    def record(self, address, seconds):
+        """Keep the slowest turnaround seen from a node."""
+        seconds = max(0.0, seconds)
+        self.turnaround[address] = max(seconds, self.turnaround.get(address, 0.0))
+
+    def allowance(self, address=None, default=TURNAROUND_DEFAULT):
+        """Time a node may take to start its reply, nodes not measured use the slowest one."""
+        turnaround = self.turnaround.get(address)
+        if turnaround is None and self.turnaround:
+            turnaround = max(self.turnaround.values())
+        if turnaround is None:
+            return default
+        return max(TURNAROUND_MIN, turnaround * TURNAROUND_MARGIN)
+
+    def response_timeout(self, address, data_len, work=0.0, default=TURNAROUND_DEFAULT):
+        """Time from the end of a request to the end of the reply."""
+        return self.allowance(address, default) + work + self.response_time(data_len)
+
+    def slot_ms(self, data_len):
+        """Slot of one node in a BOOT_SLOTTED query, whole milliseconds."""
+        return math.ceil((self.response_time(data_len) + SLOT_GUARD) * 1000)
+
+    def settle_time(self):
+        """Gap after a broadcast all nodes answer, until the bus is quiet."""
+        turnaround = max(self.turnaround.values(), default=0.0)
+        return max(TURNAROUND_MIN, turnaround * TURNAROUND_MARGIN) + self.response_time(0)
+
+
+class BusConsole:
+    """
+    Shared terminal for sessions on several buses. Log lines are prefixed
+    with the port and one progress line is kept for all buses together.
+    """
+    def __init__(self):
+        self.lock = threading.Lock()
+        self.buses = {}
+        self.width = 0
+        self.last_draw = 0.0
+
+    def log(self, name, message):
+        message = message.strip('\n')
+        if not message:
+            return
+        with self.lock:
+            self._clear()
+            print(f"[{name}] {message}")
+            self._draw()
+
+    def progress(self, name, label, done, total):
+        with self.lock:
+            self.buses[name] = (label, done, total)
+            # Redraw at most 10 times per second, and always at the end of a block list.
+            now = time.perf_counter()
+            if done == total or now - self.last_draw >= 0.1:
+                self.last_draw = now
+                self._clear()
+                self._draw()
+
+    def _clear(self):
+        if self.width:
+            sys.stdout.write('\r' + ' ' * self.width + '\r')
+
+    def _draw(self):
+        if not self.buses:
+            return
+        done = sum(d for _, d, _ in self.buses.values())
+        total = sum(t for _, _, t in self.buses.values())
+        slowest, (label, d, t) = min(self.buses.items(), key=lambda b: b[1][1] / b[1][2])
+        line = (f"{len(self.buses)} buses Block {done}/{total} [{done / total * 100:.1f}%]"
+                f" | slowest {slowest} {label} {d}/{t}")
+        sys.stdout.write(line)
+        sys.stdout.flush()
+        self.width = len(line)
+
 
 class CH32V003Bootloader:
     HDR_MASK_TYPE = 0x01   # 0b0000 0001 (0 = Request, 1 = Response)
     
-    def __init__(self, port, baud=9600, verbose=False):
+    def __init__(self, port, baud=DEFAULT_BAUD, verbose=False, console=None):
         self.verbose = verbose
+        self.name = port
+        self.console = console
         try:
-            self.ser = serial.Serial(port, baud, timeout=0.01, stopbits=serial.STOPBITS_TWO)
+            self.ser = serial.Serial(port, baud, timeout=0.1, stopbits=serial.STOPBITS_TWO)
         except serial.SerialException as e:
             self._log(f"Error opening serial port {port}: {e}")
             return
             
         self.rx_queue = queue.Queue()
+        self.parser = FrameParser()
         self.stop_thread = False
         self.serial_lock = threading.Lock()
+
+        # When the last sent byte leaves the adapter, flush() does not wait
+        # for that on all adapters (e.g. CH340) and not on a pty.
+        self.tx_done = 0.0
+
+        # When the nodes are done with the flash, and how much they can receive
+        # meanwhile (0 = only the DATAR register, the preamble covers that).
+        self.node_busy = 0.0
+        self.rx_buffer = 0
+        self.preamble_count = PREAMBLE_TX_COUNT
+
+        # Max BOOT_WRITE_PACKED stream, 0 = raw writes only.
+        self.pack_max = 0
+
+        # Writes are sent as a burst, frames after the first without preamble.
+        self.burst = False
+        self.burst_next = False
+        self.burst_count = 0
+
+        self.timing = BusTiming(baud)
+        # Last time anything was received, echo of our own requests included.
+        self.rx_last = 0.0
         
         self.thread = threading.Thread(target=self._uart_reader_thread, daemon=True)
         self.thread.start()
 
     def _log(self, message, end='\n'):
-        if self.verbose:
+        if self.console:
+            self.console.log(self.name, message)
+        elif self.verbose:
             print(message, end=end)
             sys.stdout.flush()
             
@@ -70,77 +575,20 @@ class CH32V003Bootloader:
         return binascii.crc32(data) & 0xFFFFFFFF
 
     def _uart_reader_thread(self):
-        raw_buffer = bytearray()
-        HDR_MASK_TYPE = 0x01
-
         while not self.stop_thread:
             try:
-                if self.ser.in_waiting > 0:
-                    with self.serial_lock:
-                        raw_buffer.extend(self.ser.read(self.ser.in_waiting))
-                
-                while len(raw_buffer) >= (PREAMBLE_RX_COUNT + 8):
-                    pre_len = 0
-                    hdr_pos = -1
-                    
-                    for i in range(len(raw_buffer)):
-                        if raw_buffer[i] == PREAMBLE_BYTE:
-                            pre_len += 1
-                        else:
-                            if pre_len >= PREAMBLE_RX_COUNT:
-                                hdr_pos = i
-                                break
-                            pre_len = 0
-                    
-                    if hdr_pos == -1:
-                        raw_buffer = raw_buffer[-PREAMBLE_RX_COUNT:]
-                        break
-
-                    hdr = raw_buffer[hdr_pos]
-                    if (hdr & 0xF0) != HDR_MASK_BASE:
-                        raw_buffer = raw_buffer[hdr_pos + 1:]
-                        continue
-                    
-                    if not (hdr & HDR_MASK_TYPE):
-                        raw_buffer = raw_buffer[hdr_pos + 1:]
-                        continue
-
-                    is_64 = (hdr & HDR_FLAG_64BIT) != 0
-                    addr_len = 8 if is_64 else 1
-                    len_idx = hdr_pos + 1 + addr_len + 1
-                    
-                    if len(raw_buffer) <= len_idx: 
-                        break 
-                    
-                    data_len = raw_buffer[len_idx]
-                    total_packet_len = 1 + addr_len + 1 + 1 + data_len + 4 
-                    
-                    if len(raw_buffer) < (hdr_pos + total_packet_len):
-                        break 
-
-                    payload_for_crc = raw_buffer[hdr_pos : hdr_pos + total_packet_len - 4]
-                    rx_crc = struct.unpack('<I', raw_buffer[hdr_pos + total_packet_len - 4 : hdr_pos + total_packet_len])[0]
-                    
-                    if rx_crc == self._calculate_crc32(payload_for_crc):
-                        packet_data = raw_buffer[hdr_pos : hdr_pos + total_packet_len]
-                        addr_raw = packet_data[1 : 1 + addr_len]
-                        
-                        self.rx_queue.put({
-                            'node_id': addr_raw[0] if addr_len == 1 else None,
-                            'uid': addr_raw.hex().upper() if addr_len == 8 else None,
-                            'cmd': packet_data[1 + addr_len],
-                            'data': packet_data[1 + addr_len + 2 : 1 + addr_len + 2 + data_len],
-                            'raw': packet_data
-                        })
-                        raw_buffer = raw_buffer[hdr_pos + total_packet_len:]
-                    else:
-                        raw_buffer = raw_buffer[hdr_pos + 1:]
-                
-                time.sleep(0.001)
+                # Blocks until at least one byte arrived or the port timeout.
+                data = self.ser.read(max(1, self.ser.in_waiting))
+                if data:
+                    now = time.perf_counter()
+                    self.rx_last = now
+                    for frame in self.parser.feed(data):
+                        frame['time'] = now
+                        self.rx_queue.put(frame)
             except Exception:
                 time.sleep(0.01)
 
-    def send_packet(self, address, cmd, data=None):
+    def send_packet(self, address, cmd, data=None, burst=False):
         if data is None: data = []
         while not self.rx_queue.empty(): self.rx_queue.get_nowait()
 
@@ -158,18 +606,87 @@ class CH32V003Bootloader:
         else:
             raise ValueError(f"Invalid Address: {address}")
 
-        payload = bytes([hdr]) + addr_bytes + bytes([cmd & 0xFF, len(data) & 0xFF]) + bytes(data)
+        if len(data) > 255:
+            # Extended frame, 16bit length.
+            hdr |= HDR_FLAG_EXT_LEN
+            length = struct.pack('<H', len(data))
+        else:
+            length = bytes([len(data)])
+
+        # Burst frames follow the previous burst frame directly, a preamble
+        # now and then lets nodes that lost a frame join again.
+        preamble = self.preamble_count
+        if burst:
+            hdr |= HDR_FLAG_BURST
+            if self.burst_next and self.burst_count < BURST_MAX_FRAMES:
+                preamble = 0
+                self.burst_count += 1
+            else:
+                self.burst_count = 1
+        self.burst_next = burst
+
+        payload = bytes([hdr]) + addr_bytes + bytes([cmd & 0xFF]) + length + bytes(data)
         crc = self._calculate_crc32(payload)
-        full_packet = bytes([PREAMBLE_BYTE] * PREAMBLE_TX_COUNT) + payload + struct.pack('<I', crc)
+        full_packet = bytes([PREAMBLE_BYTE] * preamble) + payload + struct.pack('<I', crc)
         
+        self._wait_nodes()
+        start = time.perf_counter()
         with self.serial_lock:
             self.ser.write(full_packet)
             self.ser.flush()
+        self.tx_done = max(start, self.tx_done) + len(full_packet) * self.timing.byte_time()
+
+    def _wait_nodes(self):
+        """Wait until the next frame can be sent without the nodes losing its header."""
+        byte_time = self.timing.byte_time()
+        if self.rx_buffer:
+            slack = self.rx_buffer * byte_time
+        else:
+            # Bytes received while flash is busy are lost, only spare preamble may be.
+            slack = (self.preamble_count - PREAMBLE_RX_COUNT - 1) * byte_time
+
+        # Writes queue behind the previous frame, a late start needs no sleep.
+        delay = self.node_busy - slack - time.perf_counter()
+        if delay > 0:
+            time.sleep(delay)
+
+    def _wait_bus(self, seconds):
+        """Sleep until the last packet has been sent plus seconds."""
+        delay = self.tx_done + seconds - time.perf_counter()
+        if delay > 0:
+            time.sleep(delay)
+
+    def _settle(self):
+        """Wait for the replies to a broadcast all nodes answer, busy nodes answer when done."""
+        gap = self.timing.settle_time()
+        deadline = max(self.tx_done, self.node_busy) + gap
+        limit = deadline + TURNAROUND_DEFAULT
+        # Nodes behind the model (slower flash, adapter latency) answer later,
+        # wait until the bus has been quiet for a gap.
+        while True:
+            end = min(max(deadline, self.rx_last + gap), limit)
+            delay = end - time.perf_counter()
+            if delay <= 0:
+                break
+            time.sleep(delay)
 
     def get_response(self, timeout=0.5):
         try: return self.rx_queue.get(timeout=timeout)
         except queue.Empty: return None
 
+    def get_reply(self, address, length, work=0.0):
+        """
+        Reply to the last request. Waits for the reply air time and the node
+        turnaround measured so far, and measures it again.
+        """
+        # Nodes answer when the request is sent and the flash is idle.
+        start = max(self.tx_done, self.node_busy)
+        timeout = start + self.timing.response_timeout(address, length, work) - time.perf_counter()
+        resp = self.get_response(timeout=max(0.001, timeout))
+        if resp:
+            self.timing.record(address, resp['time'] - start - work - self.timing.response_time(len(resp['data'])))
+        return resp
+
     # --- High Level Commands ---
 
     def set_fw_id(self, address, fw_id):
@@ -177,7 +694,7 @@ class CH32V003Bootloader:
         self._log(f"Setting FW_ID to {fw_id} for {address}...")
         # Payload: [Type (0x00), fw_id]
         self.send_packet(address, BOOT_SET_NODE_INFO, [0x00, fw_id & 0xFF])
-        resp = self.get_response()
+        resp = self.get_reply(address, 0, OPTION_WRITE_TIME)
         if resp:
             self._log("FW_ID updated successfully.")
             return True
@@ -189,13 +706,108 @@ class CH32V003Bootloader:
         self._log(f"Setting Node ID to {node_id} for {address}...")
         # Payload: [Type (0x01), node_id]
         self.send_packet(address, BOOT_SET_NODE_INFO, [0x01, node_id & 0xFF])
-        resp = self.get_response()
+        resp = self.get_reply(address, 0, OPTION_WRITE_TIME)
         if resp:
             self._log("Node ID updated successfully.")
             return True
         self._log("No response from node.")
         return False
 
+    def slotted_query(self, cmd, data, length, targets, work=0.0):
+        """
+        One broadcast query answered by every node in the slot of its node-id
+        (BOOT_SLOTTED). targets maps UID -> info with 'node_id'. Returns UID ->
+        response of the targets that answered. Targets sharing a node-id
+        collide and are left out.
+        """
+        owners = {}
+        for uid, inf in targets.items():
+            owners.setdefault(inf['node_id'], []).append(uid)
+        expected = {node_id: uids[0] for node_id, uids in owners.items() if len(uids) == 1}
+        slot_ms = self.timing.slot_ms(length)
+        if not expected or slot_ms > SLOT_MAX_MS:
+            return {}
+
+        last_id = max(owners)
+        self.send_packet(BROADCAST_ID, BOOT_SLOTTED, bytes([slot_ms, last_id, cmd]) + bytes(data))
+
+        # Nodes past last_id do not answer, the last slot ends the query.
+        slots = (last_id + 1) * slot_ms / 1000 * (1 + SLOT_CLOCK_TOLERANCE)
+        end = self.tx_done + self.timing.allowance() + work + slots
+        replies = {}
+        while True:
+            timeout = end - time.perf_counter()
+            if timeout <= 0:
+                break
+            resp = self.get_response(timeout=timeout)
+            if resp and resp['cmd'] == cmd and len(resp['data']) == length:
+                if resp['node_id'] in expected:
+                    replies[expected[resp['node_id']]] = resp
+                if resp['node_id'] == last_id:
+                    break
+        return replies
+
+    def query_targets(self, targets, cmd, data, length, parse, single, work=0.0):
+        """
+        parse() of the reply of every target. One slotted query when all
+        targets support BOOT_CAP_SLOTTED, single(uid) for the targets without
+        a valid reply in it.
+        """
+        replies = {}
+        slotted = targets and all('node_id' in inf and inf.get('caps', 0) & BOOT_CAP_SLOTTED
+                                  for inf in targets.values())
+        if slotted:
+            replies = self.slotted_query(cmd, data, length, targets, work)
+
+        results = {uid: parse(replies.get(uid)) for uid in targets}
+        missing = [uid for uid, value in results.items() if value is None]
+        if slotted and missing:
+            self._log(f"Slotted query 0x{cmd:02X}: no reply in the slot of {len(missing)} node(s), "
+                      f"asking one by one: {', '.join(missing)}")
+        for uid in missing:
+            results[uid] = single(uid)
+        return results
+
+    def get_info(self, address):
+        """Bootloader version and capabilities, caps is 0 on old bootloaders."""
+        self.send_packet(address, BOOT_GET_INFO)
+        return self.parse_info(self.get_reply(address, 6))
+
+    @staticmethod
+    def parse_info(resp):
+        if resp and resp['cmd'] == BOOT_GET_INFO and len(resp['data']) >= 2:
+            data = bytes(resp['data'])
+            caps = struct.unpack('<I', data[2:6])[0] if len(data) >= 6 else 0
+            return {'major': data[0], 'minor': data[1], 'caps': caps}
+        return None
+
+    def set_baud(self, baud, targets=None):
+        """
+        Switch all nodes and the host to a new baudrate.
+        Nodes fall back to 9600 bps if the confirm is not received.
+        Returns the targets not answering on the new baudrate.
+        """
+        brr = int(round(NODE_CLOCK_HZ / baud))
+        self._log(f"Switching bus to {baud} bps (BRR={brr})...")
+        self.send_packet(BROADCAST_ID, BOOT_SET_BAUD, struct.pack('<H', brr))
+
+        # Let the last byte leave the adapter before changing speed.
+        self._wait_bus(0.01)
+        with self.serial_lock:
+            self.ser.baudrate = baud
+        self.timing.baud = baud
+        time.sleep(0.01)
+
+        # Any valid packet on the new baudrate confirms it.
+        self.send_packet(BROADCAST_ID, BOOT_SET_BAUD, struct.pack('<H', brr))
+        if not targets:
+            return []
+
+        # The query also confirms nodes that missed the confirm, a node that
+        # missed the switch is still on the old baudrate and stays silent.
+        infos = self.query_targets(targets, BOOT_GET_INFO, [], 6, self.parse_info, self.get_info)
+        return [uid for uid, info in infos.items() if info is None]
+
     def enter_bootloader(self, duration=1.0):
         self._log(f"Holding synchronization (entering bootloader)...")
         start_time = time.time()
@@ -205,6 +817,81 @@ class CH32V003Bootloader:
         time.sleep(0.2)
 
     def search_nodes(self, slots=100, retries=3):
+        """
+        Search with BOOT_SEARCH_UID tree-walk, falls back to the random slot
+        search if no node answers.
+        """
+        devices = self.search_nodes_tree()
+        if devices:
+            return devices
+        self._log("No answer to BOOT_SEARCH_UID, falling back to the slot search")
+        return self.search_nodes_slots(slots, retries)
+
+    def _search_uid_query(self, mask, value):
+        """
+        Ask nodes with (UID & mask) == value to answer.
+        Returns (responses, collision).
+        """
+        errors = self.parser.errors
+        self.send_packet(BROADCAST_ID, BOOT_SEARCH_UID, struct.pack('<QQ', mask, value))
+
+        # Reply air time plus the turnaround of the slowest node seen. Collisions
+        # are seen as CRC errors. Until a reply is measured the default covers
+        # the USB-serial adapter latency, an empty root query means no nodes.
+        end = self.tx_done + self.timing.response_timeout(BROADCAST_ID, 14)
+        responses = []
+        while time.perf_counter() < end:
+            resp = self.get_response(timeout=max(0.001, end - time.perf_counter()))
+            if resp and resp['cmd'] == BOOT_SEARCH_UID and len(resp['data']) == 14:
+                responses.append(resp)
+                # A second reply queues behind the first, only the first is a turnaround.
+                if len(responses) == 1 and self.parser.errors == errors:
+                    uid = bytes(resp['data'][0:8]).hex().upper()
+                    self.timing.record(uid, resp['time'] - self.tx_done - self.timing.response_time(14))
+        return responses, self.parser.errors != errors
+
+    def search_nodes_tree(self):
+        """
+        Deterministic discovery, binary walk over the 64bit UID.
+        A prefix is split only when more than one node answer.
+        """
+        self._log("Searching nodes (UID tree-walk)...")
+        self.send_packet(BROADCAST_ID, BOOT_UNSILENCE)
+        self._settle()
+
+        discovered_devices = {}
+        stack = [(0, 0)]
+        while stack:
+            value, bits = stack.pop()
+            responses, collision = self._search_uid_query((1 << bits) - 1, value)
+
+            for resp in responses:
+                data = bytes(resp['data'])
+                uid = data[0:8].hex().upper()
+                if uid not in discovered_devices:
+                    discovered_devices[uid] = {'node_id': data[8], 'fw': data[9],
+                                               'caps': struct.unpack('<I', data[10:14])[0]}
+                    self._log(f"Found {uid}")
+                    if collision:
+                        # Keep it quiet while the rest of the prefix is searched.
+                        self.send_packet(uid, BOOT_SILENCE)
+
+            if collision and bits < 64:
+                stack.append((value | (1 << bits), bits + 1))
+                stack.append((value, bits + 1))
+
+        self.send_packet(BROADCAST_ID, BOOT_UNSILENCE)
+        self._settle()
+
+        self._log(f"Found {len(discovered_devices)} unique nodes:")
+        self._log(f"{'UID':<20} | {'Node-ID':<10} | {'FW-ID':<10}")
+        self._log("-" * 46)
+        for uid, info in discovered_devices.items():
+            self._log(f"{uid:<20} | {info['node_id']:<10} | {info['fw']:<10}")
+        self._log("")
+        return discovered_devices
+
+    def search_nodes_slots(self, slots=100, retries=3):
         """
         1. Scans for nodes using collision avoidance.
         2. Unsilences all nodes.
@@ -213,14 +900,19 @@ class CH32V003Bootloader:
         self._log(f"Scanning for nodes ({slots} slots)...")
         uids_found = [] 
 
-        # Discover UIDs
+        # Discover UIDs, all nodes answer the unsilence at once.
         self.send_packet(BROADCAST_ID, BOOT_UNSILENCE)
+        self._settle()
         for attempt in range(retries):
             # Request IDs from nodes
+            errors = self.parser.errors
+            found = len(uids_found)
             self.send_packet(BROADCAST_ID, BOOT_GET_ID, [max(0, slots-32)])
-            end_search = time.time() + (slots * 0.05) + 0.2
+
+            # Last slot plus the reply, nodes pick at most slots-32+32 slots.
+            end_search = self.tx_done + max(32, slots) * SEARCH_SLOT_TIME + self.timing.response_timeout(BROADCAST_ID, 8)
             
-            while time.time() < end_search:
+            while time.perf_counter() < end_search:
                 resp = self.get_response(timeout=0.02)
                 if resp and resp['cmd'] == BOOT_GET_ID:
                     uid_hex = bytes(resp['data']).hex().upper()
@@ -229,10 +921,14 @@ class CH32V003Bootloader:
                         self._log(f"Found {uid_hex}")
                         # Silence this specific node so others can respond
                         self.send_packet(uid_hex, BOOT_SILENCE)
+
+            # Nothing new and no collisions, no node left to answer.
+            if len(uids_found) == found and self.parser.errors == errors:
+                break
         
         # Unsilence all nodes before querying info
         self.send_packet(BROADCAST_ID, BOOT_UNSILENCE)
-        time.sleep(0.05) # Brief pause to ensure bus is ready
+        self._settle()
 
         self._log("")
         self._log(f"Found {len(uids_found)} unique nodes:")
@@ -254,12 +950,79 @@ class CH32V003Bootloader:
 
     def get_node_info(self, address):
         self.send_packet(address, BOOT_GET_NODE_INFO)
-        resp = self.get_response(timeout=0.5)
+        resp = self.get_reply(address, 2)
         if resp and resp['cmd'] == BOOT_GET_NODE_INFO and len(resp['data']) >= 2:
             return {'node_id': resp['data'][0], 'fw': resp['data'][1]}
         return None
 
-    def update_firmware(self, firmware_data, fw_id=0):
+    def find_targets(self, fw_id, slots=63):
+        """Search the bus, return info and capabilities of all nodes with fw_id."""
+        targets = {}
+        for uid, inf in self.search_nodes(slots).items():
+            if inf['fw'] != fw_id:
+                continue
+            if 'caps' not in inf:
+                info = self.get_info(uid)
+                inf = dict(inf, caps=info['caps'] if info else 0)
+            targets[uid] = inf
+        return targets
+
+    @staticmethod
+    def common_caps(targets):
+        """Capabilities supported by all targets."""
+        caps = None
+        for inf in targets.values():
+            caps = inf['caps'] if caps is None else caps & inf['caps']
+        return caps or 0
+
+    def get_crc_map(self, address, start, block_size, count):
+        """CRC32 of count blocks of block_size (64 or 1024) bytes from start, None on timeout."""
+        shift = block_size.bit_length() - 1
+        crcs = []
+        while len(crcs) < count:
+            n = min(CRC_MAP_MAX_COUNT, count - len(crcs))
+            payload = struct.pack('<IBB', start + len(crcs) * block_size, shift, n)
+            self.send_packet(address, BOOT_GET_CRC_MAP, payload)
+            resp = self.get_reply(address, n * 4, n * block_size * CRC_TIME_PER_BYTE)
+            if not resp or resp['cmd'] != BOOT_GET_CRC_MAP or len(resp['data']) != n * 4:
+                return None
+            crcs += struct.unpack(f'<{n}I', bytes(resp['data']))
+        return crcs
+
+    def changed_pages(self, firmware_data, targets):
+        """
+        Pages that differ on at least one target, compares sectors first and
+        then pages inside the differing sectors. A partial last sector is
+        compared per page, the node CRC would cover flash past the image.
+        None if a node does not answer.
+        """
+        total_pages = len(firmware_data) // 64
+        sectors = total_pages // 16
+        changed = set()
+
+        for uid in targets:
+            sector_crcs = self.get_crc_map(uid, 0x08000000, 1024, sectors) if sectors else []
+            if sector_crcs is None:
+                return None
+
+            runs = [(sector * 16, 16) for sector, crc in enumerate(sector_crcs)
+                    if crc != self._calculate_crc32(firmware_data[sector * 1024 : (sector + 1) * 1024])]
+            if total_pages > sectors * 16:
+                runs.append((sectors * 16, total_pages - sectors * 16))
+
+            for first, count in runs:
+                page_crcs = self.get_crc_map(uid, 0x08000000 + first * 64, 64, count)
+                if page_crcs is None:
+                    return None
+                for i, crc in enumerate(page_crcs):
+                    page = first + i
+                    if crc != self._calculate_crc32(firmware_data[page * 64 : (page + 1) * 64]):
+                        changed.add(page)
+
+        return sorted(changed)
+
+    def update_firmware(self, firmware_data, fw_id=0, caps=0, targets=None, delta=False, blank=()):
+        """Write the image, returns the UIDs of targets known to be incomplete."""
         if len(firmware_data) % 64 != 0:
             padding = 64 - (len(firmware_data) % 64)
             firmware_data += b'\xFF' * padding
@@ -268,53 +1031,745 @@ class CH32V003Bootloader:
         self._log(f"Flashing {len(firmware_data)} bytes ({total_blocks} blocks) to FW-ID: 0x{fw_id:02X}")
         
         start_time = time.perf_counter()
+
+        # Only write pages that differ on any of the targets.
+        pages = list(range(total_blocks))
+        if delta and targets and (caps & BOOT_CAP_CRC_MAP):
+            changed = self.changed_pages(firmware_data, targets)
+            if changed is not None:
+                pages = changed
+                self._log(f"Delta: {len(pages)} of {total_blocks} blocks differ")
+
+        # Pages without content are only erased.
+        erase_only = [p for p in pages if p in blank]
+        pages = [p for p in pages if p not in blank]
+        if erase_only:
+            self._log(f"Sparse image: {len(pages)} blocks written, {len(erase_only)} blank blocks erased")
+
+        # Write a whole sector per packet when all nodes support it.
+        pages_per_write = EXT_WRITE_PAGES if caps & BOOT_CAP_EXT_FRAME else 1
+
+        # Nodes buffer frames while flash is busy, stream with a short preamble.
+        if caps & BOOT_CAP_UART_DMA:
+            self.rx_buffer = DMA_RX_BYTES
+            self.preamble_count = PREAMBLE_RX_COUNT + 1
+
+        # Packed pages, the stream must fit in one frame.
+        if caps & BOOT_CAP_PACKED_WRITE:
+            self.pack_max = EXT_PACKED_STREAM_MAX if caps & BOOT_CAP_EXT_FRAME else PACKED_STREAM_MAX
+
+        # Writes without preamble. Needs DMA, without it the preamble covers the
+        # flash busy time and would only be replaced by a gap.
+        if caps & BOOT_CAP_BURST and caps & BOOT_CAP_UART_DMA:
+            self.burst = True
+
         self.send_packet(BROADCAST_ID, BOOT_SILENCE)
 
-        for i, offset in enumerate(range(0, len(firmware_data), 64)):
-            chunk = firmware_data[offset:offset+64]
-            self._broadcast_update_block(i, chunk, fw_id)
-            
-            # Progress bar
-            percent = (i + 1) / total_blocks * 100
-            sys.stdout.write(f"\rWriting Block {i+1}/{total_blocks} [{percent:.1f}%]")
-            sys.stdout.flush()
+        # Start counting written/skipped pages from zero.
+        if caps & BOOT_CAP_SKIP_SAME:
+            self.send_packet(BROADCAST_ID, BOOT_GET_WRITE_STATS, [1])
+
+        # Start a new received-page bitmap.
+        if caps & BOOT_CAP_WRITE_MAP:
+            self.send_packet(BROADCAST_ID, BOOT_GET_WRITE_MAP, [1])
+
+        # Start new per sector write CRCs.
+        if caps & BOOT_CAP_WRITE_CRC:
+            self.send_packet(BROADCAST_ID, BOOT_GET_WRITE_CRC, [1])
+
+        # Erase with sector erase up front, nodes skip the per page erase.
+        # Nodes comparing pages (SKIP_SAME) erase only what differs, an erase
+        # up front would make every page differ. Only blank pages are erased.
+        if caps & BOOT_CAP_RANGE_ERASE:
+            erase = erase_only if caps & BOOT_CAP_SKIP_SAME else pages + erase_only
+            for first, count in self._page_runs(sorted(erase)):
+                self.erase_range(first, first + count, fw_id)
+        else:
+            for page in erase_only:
+                self.erase_page(page, fw_id)
 
+        sent = self._write_pages(firmware_data, pages, fw_id, pages_per_write)
+        if self.pack_max:
+            self._log(f"\nPacked: {sent} bytes sent for {len(pages) * 64} bytes of pages")
+
+        # All nodes answer the broadcast at once, let the bus settle.
         self.send_packet(BROADCAST_ID, BOOT_UNSILENCE)
+        self._settle()
+
+        # Rebroadcast only the blocks a node did not receive.
+        incomplete = []
+        if targets and (caps & BOOT_CAP_WRITE_MAP):
+            incomplete = self.repair_missing(firmware_data, pages, fw_id, targets, pages_per_write)
+
+        self.rx_buffer = 0
+        self.preamble_count = PREAMBLE_TX_COUNT
+        self.pack_max = 0
+        self.burst = False
+
         self._log(f"\nFinished in {time.perf_counter() - start_time:.2f}s")
 
+        # Pages the nodes did not need to program.
+        if targets and (caps & BOOT_CAP_SKIP_SAME):
+            write_stats = self.query_targets(targets, BOOT_GET_WRITE_STATS, [], 4,
+                                             self.parse_write_stats, self.get_write_stats)
+            for uid, stats in write_stats.items():
+                if stats:
+                    self._log(f"{uid}: {stats['written']} pages written, {stats['skipped']} identical pages skipped")
+        return incomplete
+
+    def _write_pages(self, firmware_data, pages, fw_id, pages_per_write, label="Writing"):
+        """
+        Broadcast the given pages, consecutive pages share one packet.
+        Returns the number of payload bytes sent.
+        """
+        done = 0
+        sent = 0
+        while done < len(pages):
+            # Consecutive pages can share one packet.
+            block = pages[done]
+            count = 1
+            max_pages = max(pages_per_write, PACKED_WRITE_PAGES if self.pack_max else 1)
+            while (count < max_pages and done + count < len(pages)
+                   and pages[done + count] == block + count):
+                count += 1
+
+            # Packed when it is shorter than the raw pages.
+            if self.pack_max:
+                packed = self._broadcast_packed_block(block, firmware_data[block * 64 : (block + count) * 64], fw_id)
+                if packed:
+                    count, length = packed
+                    sent += length
+                    done += count
+                    self._progress(label, done, len(pages))
+                    continue
+                count = min(count, pages_per_write)
+
+            chunk = firmware_data[block * 64 : (block + count) * 64]
+            sent += len(chunk) + 6
+            if not self._broadcast_update_block(block, chunk, fw_id):
+                # No usable correction for the large frame, fall back to single pages.
+                count = 1
+                self._broadcast_update_block(block, chunk[:64], fw_id)
+                sent -= len(chunk) - 64
+            done += count
+            self._progress(label, done, len(pages))
+        return sent
+
+    def _progress(self, label, done, total):
+        """Progress bar"""
+        if self.console:
+            self.console.progress(self.name, label, done, total)
+            return
+        percent = done / total * 100
+        sys.stdout.write(f"\r{label} Block {done}/{total} [{percent:.1f}%]")
+        sys.stdout.flush()
+
+    def get_write_map(self, address, reset=False):
+        """Set of pages the node received since last reset, None if no response."""
+        self.send_packet(address, BOOT_GET_WRITE_MAP, [1] if reset else [])
+        return self.parse_write_map(self.get_reply(address, 32))
+
+    @staticmethod
+    def parse_write_map(resp):
+        if resp and resp['cmd'] == BOOT_GET_WRITE_MAP and len(resp['data']) == 32:
+            bitmap = resp['data']
+            return {i for i in range(256) if bitmap[i >> 3] & (1 << (i & 7))}
+        return None
+
+    def get_write_crc(self, address, reset=False):
+        """Pages written in order per sector and CRC32 of the sector states, None if no response."""
+        self.send_packet(address, BOOT_GET_WRITE_CRC, [1] if reset else [])
+        return self.parse_write_crc(self.get_reply(address, 20))
+
+    @staticmethod
+    def parse_write_crc(resp):
+        if resp and resp['cmd'] == BOOT_GET_WRITE_CRC and len(resp['data']) == 20:
+            return list(resp['data'][:16]), struct.unpack('<I', resp['data'][16:])[0]
+        return None
+
+    @staticmethod
+    def expected_write_crc(firmware_data):
+        """BOOT_GET_WRITE_CRC response of a node that received the whole image in order."""
+        padding = (64 - (len(firmware_data) % 64)) % 64
+        data = firmware_data + b'\xff' * padding
+
+        pages = []
+        states = []
+        for sector in range(16):
+            chunk = data[sector * 1024:(sector + 1) * 1024]
+            pages.append(len(chunk) // 64)
+            # Running state on the node is the CRC before the final xor.
+            states.append(binascii.crc32(chunk) ^ 0xFFFFFFFF if chunk else 0)
+        return pages, binascii.crc32(struct.pack('<16I', *states)) & 0xFFFFFFFF
+
+    def repair_missing(self, firmware_data, pages, fw_id, targets, pages_per_write=1):
+        """
+        Ask every target which pages it received and rebroadcast the pages
+        any node missed. Returns the UIDs still missing pages or not answering.
+        """
+        incomplete = {}
+        unreachable = []
+        for attempt in range(REPAIR_ROUNDS + 1):
+            missing = set()
+            incomplete = {}
+            maps = self.query_targets(targets, BOOT_GET_WRITE_MAP, [], 32,
+                                      self.parse_write_map, self.get_write_map)
+            for uid, received in maps.items():
+                # No answer, ask it again. A rebroadcast would not reach it either.
+                for _ in range(WRITE_MAP_RETRIES):
+                    if received is not None:
+                        break
+                    received = self.get_write_map(uid)
+                if received is None:
+                    unreachable.append(uid)
+                    continue
+
+                lost = set(pages) - received
+                if lost:
+                    incomplete[uid] = lost
+                    missing |= lost
+
+            targets = {uid: inf for uid, inf in targets.items() if uid not in unreachable}
+            if not missing:
+                incomplete = {}
+                break
+            if attempt == REPAIR_ROUNDS:
+                break
+
+            self._log(f"\nRepair {attempt + 1}: {len(missing)} blocks missed by {len(incomplete)} node(s)")
+            self.send_packet(BROADCAST_ID, BOOT_SILENCE)
+            self._write_pages(firmware_data, sorted(missing), fw_id, pages_per_write, "Repairing")
+            self.send_packet(BROADCAST_ID, BOOT_UNSILENCE)
+            self._settle()
+
+        for uid, lost in incomplete.items():
+            self._log(f"{uid}: {len(lost)} blocks still missing")
+        for uid in unreachable:
+            self._log(f"{uid}: no write map, unreachable")
+        return list(incomplete) + unreachable
+
+    def get_stats(self, address, reset=False):
+        """Node error counters (BOOT_CAP_STATS), None if no response."""
+        self.send_packet(address, BOOT_GET_STATS, [1] if reset else [])
+        return self.parse_stats(self.get_reply(address, struct.calcsize(STATS_FORMAT)))
+
+    @staticmethod
+    def parse_stats(resp):
+        if resp and resp['cmd'] == BOOT_GET_STATS and len(resp['data']) == struct.calcsize(STATS_FORMAT):
+            return dict(zip(STATS_FIELDS, struct.unpack(STATS_FORMAT, bytes(resp['data']))))
+        return None
+
+    def get_write_stats(self, address, reset=False):
+        """Pages written and skipped (already identical) since last reset."""
+        self.send_packet(address, BOOT_GET_WRITE_STATS, [1] if reset else [])
+        return self.parse_write_stats(self.get_reply(address, 4))
+
+    @staticmethod
+    def parse_write_stats(resp):
+        if resp and resp['cmd'] == BOOT_GET_WRITE_STATS and len(resp['data']) == 4:
+            written, skipped = struct.unpack('<HH', bytes(resp['data']))
+            return {'written': written, 'skipped': skipped}
+        return None
+
+    @staticmethod
+    def _page_runs(pages, max_count=None):
+        """Split a sorted page list into (first, count) runs of consecutive pages."""
+        runs = []
+        for page in pages:
+            if runs and runs[-1][0] + runs[-1][1] == page and (max_count is None or runs[-1][1] < max_count):
+                runs[-1][1] += 1
+            else:
+                runs.append([page, 1])
+        return [tuple(r) for r in runs]
+
+    def erase_range(self, start, end, fw_id, address=BROADCAST_ID):
+        """Erase blocks [start, end), nodes use 1KB sector erase where aligned."""
+        self.send_packet(address, BOOT_ERASE, struct.pack('<BHH', fw_id & 0xFF, start, end))
+
+        # Wait for the nodes, they can not receive while erasing.
+        sectors = 0
+        block = start
+        while block < end:
+            if block % 16 == 0 and end - block >= 16:
+                sectors += 1
+                block += 16
+            else:
+                block += 1
+        self._wait_bus(sectors * SECTOR_ERASE_TIME + (end - start - sectors * 16) * PAGE_ERASE_TIME)
+
+    def erase_page(self, block, fw_id, address=BROADCAST_ID):
+        """Erase one 64 byte block."""
+        self.send_packet(address, BOOT_ERASE, struct.pack('<BH', fw_id & 0xFF, block))
+        self._wait_bus(PAGE_ERASE_TIME)
+
+    def erase_all(self, fw_id, address=BROADCAST_ID):
+        """Erase the whole application on all nodes with fw_id."""
+        self._log(f"Erasing application on FW-ID: 0x{fw_id:02X}")
+        self.send_packet(address, BOOT_ERASE, struct.pack('<BH', fw_id & 0xFF, ERASE_ALL_BLOCK))
+        self._wait_bus(16 * SECTOR_ERASE_TIME)
+
+    def _find_correction(self, raw, max_run=1):
+        """
+        Find a correction so the payload never contains max_run 0x7F in a row.
+        Returns None if no correction exists.
+        """
+        for corr in range(256):
+            run = 0
+            for b in raw:
+                run = run + 1 if (b - corr) % 256 == PREAMBLE_BYTE else 0
+                if run >= max_run:
+                    break
+            else:
+                return corr
+        return None
+
     def _broadcast_update_block(self, block_index, data, fw_id):
+        """Write one or more consecutive 64 byte pages, returns False if not sent."""
         address = 0x08000000 + (block_index * 64)
         raw_block = struct.pack('<I', address) + data
+        pages = len(data) // 64
         
-        corr = 0
-        for attempt in range(256):
-            if all((b - attempt) % 256 != PREAMBLE_BYTE for b in raw_block):
-                corr = attempt
-                break
+        if pages == 1:
+            corr = self._find_correction(raw_block) or 0
+        else:
+            # Node only resyncs on a full preamble, allow shorter 0x7F runs.
+            corr = self._find_correction(raw_block, PREAMBLE_RX_COUNT)
+            if corr is None:
+                return False
         
         corrected_payload = bytes([(b - corr) % 256 for b in raw_block])
         write_payload = bytes([fw_id & 0xFF, corr & 0xFF]) + corrected_payload
-        self.send_packet(BROADCAST_ID, BOOT_WRITE, write_payload)
+        self.send_packet(BROADCAST_ID, BOOT_WRITE, write_payload, self.burst)
+
+        # Nodes program after the frame, the next frame waits in _wait_nodes().
+        self.node_busy = max(self.node_busy, self.tx_done) + pages * PAGE_PROGRAM_TIME
+        return True
+
+    def _broadcast_packed_block(self, block_index, data, fw_id):
+        """
+        Write consecutive pages with BOOT_WRITE_PACKED. Fewer pages are sent when
+        the stream does not fit in one frame. Returns (pages, payload bytes) or
+        None when packing is not shorter than raw writes.
+        """
+        pages = len(data) // 64
+        while pages:
+            packed = pack_pages(data[:pages * 64])
+            if len(packed) <= self.pack_max:
+                break
+            pages //= 2
+        if not pages or len(packed) >= pages * 64:
+            return None
+
+        raw_block = struct.pack('<I', 0x08000000 + block_index * 64) + packed
+        corr = self._find_correction(raw_block, PREAMBLE_RX_COUNT)
+        if corr is None:
+            return None
+
+        corrected_payload = bytes([(b - corr) % 256 for b in raw_block])
+        write_payload = bytes([fw_id & 0xFF, corr & 0xFF]) + corrected_payload
+        self.send_packet(BROADCAST_ID, BOOT_WRITE_PACKED, write_payload, self.burst)
+
+        self.node_busy = max(self.node_busy, self.tx_done) + pages * PAGE_PROGRAM_TIME
+        return pages, len(write_payload)
 
     def get_verify_crc(self, address, length):
         payload = struct.pack('<II', 0x08000000, length)
         self.send_packet(address, BOOT_GET_CRC, payload)
-        resp = self.get_response(timeout=1.0)
+        return self.parse_crc(self.get_reply(address, 4, length * CRC_TIME_PER_BYTE))
+
+    def quiet_verify(self, firmware_data, fw_id, targets):
+        """
+        Broadcast the expected CRC32 (BOOT_CAP_QUIET_VERIFY), only nodes with
+        fw_id and other flash content answer. Returns UID -> CRC32 of the
+        targets that failed, None when the replies can not be told apart
+        (collision or unknown node-id) and the targets must be asked one by one.
+        Nodes with BOOT_CAP_SLOTTED answer in the slot of their node-id, so
+        several failed nodes do not collide.
+        """
+        length = len(firmware_data)
+        expected = binascii.crc32(firmware_data) & 0xFFFFFFFF
+        owners = {}
+        for uid, inf in targets.items():
+            owners.setdefault(inf.get('node_id'), []).append(uid)
+
+        errors = self.parser.errors
+        payload = struct.pack('<IIIB', 0x08000000, length, expected, fw_id & 0xFF)
+
+        # A silent slot is a match only when no other target shares the node-id.
+        if (all(inf.get('caps', 0) & BOOT_CAP_SLOTTED for inf in targets.values())
+                and None not in owners and all(len(uids) == 1 for uids in owners.values())
+                and self.timing.slot_ms(4) <= SLOT_MAX_MS):
+            replies = self.slotted_query(BOOT_GET_CRC, payload, 4, targets, length * CRC_TIME_PER_BYTE)
+            if self.parser.errors != errors:
+                return None
+            return {uid: self.parse_crc(resp) for uid, resp in replies.items()}
+
+        self.send_packet(BROADCAST_ID, BOOT_GET_CRC, payload)
+
+        # All nodes finish the CRC at the same time, one reply window.
+        end = self.tx_done + self.timing.response_timeout(None, 4, length * CRC_TIME_PER_BYTE)
+        failed = {}
+        known = True
+        while True:
+            timeout = end - time.perf_counter()
+            if timeout <= 0:
+                break
+            resp = self.get_response(timeout=timeout)
+            crc = self.parse_crc(resp)
+            if crc is None:
+                continue
+            uids = owners.get(resp['node_id'], [])
+            if len(uids) == 1:
+                failed[uids[0]] = crc
+            else:
+                known = False
+
+        if not known or self.parser.errors != errors:
+            return None
+        return failed
+
+    @staticmethod
+    def parse_crc(resp):
         if resp and resp['cmd'] == BOOT_GET_CRC and len(resp['data']) == 4:
             return struct.unpack('<I', resp['data'])[0]
         return None
 
+    def write_trailer(self, firmware_data, fw_id):
+        """
+        Length and CRC32 of the application in the last page. Nodes with
+        BOOT_CAP_APP_CHECK start a matching application without the long wait.
+        """
+        crc = binascii.crc32(firmware_data) & 0xFFFFFFFF
+        self._log(f"Trailer: {len(firmware_data)} bytes, CRC32 0x{crc:08X}")
+        self.send_packet(BROADCAST_ID, BOOT_SILENCE)
+        self._broadcast_update_block(TRAILER_PAGE, ERASED_PAGE[:56] + struct.pack('<II', len(firmware_data), crc), fw_id)
+        self.send_packet(BROADCAST_ID, BOOT_UNSILENCE)
+        self._settle()
+
     def start_app(self):
         self._log("Starting application...")
         self.send_packet(BROADCAST_ID, BOOT_GO)
 
 
+def estimate_session(data, nodes, caps, args, blank=()):
+    """
+    Session time on one bus from the timing model, without a port. Follows
+    the same steps and frame sizes as run_bus(), nodes answer after
+    ESTIMATE_TURNAROUND. Returns the time per step.
+    """
+    timing = BusTiming(args.baud)
+    for node in range(nodes):
+        timing.record(node, ESTIMATE_TURNAROUND)
+    times = {'sync': 0.0 if args.no_sync else 1.2}
+
+    def request(data_len, addr_len=1):
+        return timing.request_time(data_len, addr_len)
+
+    def query(data_len, reply_len, work=0.0):
+        return request(data_len, 8) + ESTIMATE_TURNAROUND + work + timing.response_time(reply_len)
+
+    def query_all(data_len, reply_len, work=0.0):
+        # Node-ids 1..nodes answer in their slot of one BOOT_SLOTTED query.
+        if caps & BOOT_CAP_SLOTTED and timing.slot_ms(reply_len) <= SLOT_MAX_MS:
+            slots = (nodes + 1) * timing.slot_ms(reply_len) / 1000 * (1 + SLOT_CLOCK_TOLERANCE)
+            return request(3 + data_len) + ESTIMATE_TURNAROUND + work + slots
+        return nodes * query(data_len, reply_len, work)
+
+    def search():
+        if caps & BOOT_CAP_UID_SEARCH:
+            # Binary trie over random UIDs, ~1.44 splits per node and two queries per split.
+            queries = 1 if nodes <= 1 else round(2.9 * nodes)
+            window = request(16) + timing.response_timeout(BROADCAST_ID, 14)
+            return queries * window + nodes * request(0, 8) + 2 * (request(0) + timing.settle_time())
+        # Slot search, a round finding the nodes and an empty round.
+        window = request(1) + max(32, args.detect or 63) * SEARCH_SLOT_TIME + timing.response_timeout(BROADCAST_ID, 8)
+        return 2 * window + nodes * (request(0, 8) + query(0, 2)) + 2 * request(0)
+
+    if args.detect is not None:
+        times['detect'] = search()
+    if args.fast_baud:
+        times['detect'] = times.get('detect', 0.0) + 2 * request(2) + 0.02
+        timing.baud = args.fast_baud
+        # Every target answers on the new baudrate.
+        if args.detect is not None or args.uid:
+            times['detect'] += query_all(0, 6)
+
+    if args.write:
+        pages = (len(data) + 63) // 64
+        padded = data + b'\xff' * (pages * 64 - len(data))
+        written = [p for p in range(pages) if p not in blank]
+        t = 4 * request(1)
+        if caps & BOOT_CAP_RANGE_ERASE and not caps & BOOT_CAP_SKIP_SAME:
+            sectors = pages // 16
+            t += request(5) + sectors * SECTOR_ERASE_TIME + (pages - sectors * 16) * PAGE_ERASE_TIME
+        else:
+            t += len(blank) * (request(3) + PAGE_ERASE_TIME)
+
+        # Same schedule as _write_pages(), the next frame may start while nodes program.
+        pages_per_write = EXT_WRITE_PAGES if caps & BOOT_CAP_EXT_FRAME else 1
+        pack_max = 0
+        if caps & BOOT_CAP_PACKED_WRITE:
+            pack_max = EXT_PACKED_STREAM_MAX if caps & BOOT_CAP_EXT_FRAME else PACKED_STREAM_MAX
+        if caps & BOOT_CAP_UART_DMA:
+            preamble = PREAMBLE_RX_COUNT + 1
+            slack = DMA_RX_BYTES * timing.byte_time()
+        else:
+            preamble = PREAMBLE_TX_COUNT
+            slack = (preamble - PREAMBLE_RX_COUNT - 1) * timing.byte_time()
+        burst = caps & BOOT_CAP_BURST and caps & BOOT_CAP_UART_DMA
+
+        tx_done = t
+        frames = 0
+        node_busy = 0.0
+        i = 0
+        while i < len(written):
+            page = written[i]
+            left = 1
+            while i + left < len(written) and written[i + left] == page + left:
+                left += 1
+            count = min(max(pages_per_write, PACKED_WRITE_PAGES if pack_max else 1), left)
+            payload = None
+            while pack_max and count:
+                packed = pack_pages(padded[page * 64:(page + count) * 64])
+                if len(packed) <= pack_max:
+                    if len(packed) < count * 64:
+                        payload = 6 + len(packed)
+                    break
+                count //= 2
+            if payload is None:
+                count = min(max(count, 1), pages_per_write, left)
+                payload = 6 + count * 64
+
+            start = max(tx_done, node_busy - slack)
+            tx_done = start + timing.request_time(payload, 1, 0 if burst and frames % BURST_MAX_FRAMES else preamble)
+            frames += 1
+            node_busy = max(node_busy, tx_done) + count * PAGE_PROGRAM_TIME
+            i += count
+
+        t = max(tx_done, node_busy) + request(0) + timing.settle_time()
+        if caps & BOOT_CAP_WRITE_MAP:
+            t += query_all(0, 32)
+        if caps & BOOT_CAP_SKIP_SAME:
+            t += query_all(0, 4)
+        if args.trailer or caps & BOOT_CAP_APP_CHECK:
+            t += 2 * request(0) + request(70) + PAGE_PROGRAM_TIME + timing.settle_time()
+        times['write'] = t
+
+    if args.verify is not None:
+        t = 0.0
+        if not (args.write and args.detect is not None and caps & (BOOT_CAP_WRITE_CRC | BOOT_CAP_QUIET_VERIFY)):
+            t += search()
+        if caps & BOOT_CAP_QUIET_VERIFY and caps & BOOT_CAP_SLOTTED:
+            # One slotted broadcast, failed nodes answer in their slot.
+            t += query_all(13, 4, len(data) * CRC_TIME_PER_BYTE)
+        elif caps & BOOT_CAP_QUIET_VERIFY:
+            # One broadcast, healthy nodes stay quiet.
+            t += request(13) + timing.response_timeout(None, 4, len(data) * CRC_TIME_PER_BYTE)
+        elif args.write and caps & BOOT_CAP_WRITE_CRC and args.detect is not None:
+            t += query_all(0, 20)
+        else:
+            t += query_all(8, 4, len(data) * CRC_TIME_PER_BYTE)
+        times['verify'] = t
+
+    times['total'] = sum(times.values())
+    return times
+
+
+def run_bus(loader, args, data, blank=()):
+    """
+    Session on one bus: detect, erase, write, verify, stats, search and run.
+    Returns the number of nodes, verify failures and time per step.
+    """
+    result = {'port': loader.name, 'nodes': 0, 'failed': 0, 'error': None, 'times': {}}
+    step_start = time.perf_counter()
+
+    def step_done(step):
+        nonlocal step_start
+        now = time.perf_counter()
+        result['times'][step] = now - step_start
+        step_start = now
+
+    # Nodes already in the bootloader (warm entry by the application).
+    if not args.no_sync:
+        loader.enter_bootloader()
+
+    # Optional features supported by the target node(s).
+    targets = {}
+    if args.uid:
+        info = loader.get_info(args.uid)
+        targets[args.uid] = {'caps': info['caps'] if info else 0}
+    elif args.detect is not None:
+        targets = loader.find_targets(args.fw, args.detect)
+    caps = loader.common_caps(targets)
+    result['nodes'] = len(targets)
+
+    # Switch to high speed for the rest of the session.
+    if args.fast_baud:
+        if (args.uid or args.detect is not None) and not (caps & BOOT_CAP_SET_BAUD):
+            result['error'] = "node does not support BOOT_SET_BAUD"
+            loader._log(f"Error: {result['error']}")
+            return result
+        lost = loader.set_baud(args.fast_baud, targets)
+        if lost:
+            # Back to 9600 for everyone, the silent nodes return on their own.
+            loader.set_baud(DEFAULT_BAUD)
+            result['error'] = f"no answer at {args.fast_baud} bps from {len(lost)} node(s): {', '.join(lost)}"
+            loader._log(f"Error: {result['error']}")
+            return result
+    step_done('detect')
+
+    if args.erase_all:
+        loader.erase_all(args.fw, args.uid or BROADCAST_ID)
+
+    # Handle Writing firmware
+    if args.write:
+        incomplete = loader.update_firmware(data, args.fw, caps, targets, args.delta, blank)
+        step_done('write')
+        # Verify still runs, no trailer and no --run for an incomplete write.
+        if incomplete:
+            result['error'] = f"write incomplete on {len(incomplete)} node(s): {', '.join(incomplete)}"
+            loader._log(f"Error: {result['error']}")
+
+    # Handle Verification (Accepts value from --verify)
+    if args.verify is not None:
+        slot_count = args.verify # This will be the number after 
+        # Nodes just written keep a CRC of what they received, no search needed.
+        write_crc_targets = targets if args.write and caps & BOOT_CAP_WRITE_CRC else {}
+        written_targets = targets if args.write and caps & (BOOT_CAP_WRITE_CRC | BOOT_CAP_QUIET_VERIFY) else {}
+        if args.uid:
+            targets = {args.uid: {}}
+        else:
+            targets = written_targets or {u: inf for u, inf in loader.search_nodes(slot_count).items() if inf['fw'] == args.fw}
+        result['nodes'] = max(result['nodes'], len(targets))
+
+        expected = binascii.crc32(data) & 0xFFFFFFFF
+        length = len(data)
+        in_order = set()
+
+        # Healthy nodes stay quiet, one broadcast for all targets.
+        quiet = None
+        if targets and all(inf.get('caps', 0) & BOOT_CAP_QUIET_VERIFY for inf in targets.values()):
+            quiet = loader.quiet_verify(data, args.fw, targets)
+        if quiet is not None:
+            crcs = {uid: quiet.get(uid, expected) for uid in targets}
+        else:
+            # Just written, compare the CRC the node built while writing.
+            written = loader.query_targets(write_crc_targets, BOOT_GET_WRITE_CRC, [], 20,
+                                           loader.parse_write_crc, loader.get_write_crc)
+            in_order = {u for u, res in written.items() if res == loader.expected_write_crc(data)}
+
+            # The rest read back a CRC32 of the flash.
+            crcs = loader.query_targets({u: inf for u, inf in targets.items() if u not in in_order},
+                                        BOOT_GET_CRC, struct.pack('<II', 0x08000000, length), 4,
+                                        loader.parse_crc, lambda uid: loader.get_verify_crc(uid, length),
+                                        length * CRC_TIME_PER_BYTE)
+        for uid in targets:
+            if uid in in_order:
+                loader._log(f"Node {uid} | Expected: 0x{expected:08X} | Written in order | MATCH")
+                continue
+            if quiet is not None and uid not in quiet:
+                loader._log(f"Node {uid} | Expected: 0x{expected:08X} | Quiet | MATCH")
+                continue
+
+            res = crcs[uid]
+            status = "MATCH" if res == expected else "FAIL"
+            if res != expected:
+                result['failed'] += 1
+            loader._log(f"Node {uid} | Expected: 0x{expected:08X} | Node: {f'0x{res:08X}' if res else 'TIMEOUT'} | {status}")
+        step_done('verify')
+
+    # After the application, a node that lost a page never sees a matching trailer.
+    # The page is application flash on other bootloaders, only touched when known.
+    # A stale trailer only costs the normal wait on the node.
+    if args.write and (args.trailer or caps & BOOT_CAP_APP_CHECK) and not result['error']:
+        if len(data) > TRAILER_PAGE * 64:
+            result['error'] = f"image overlaps the trailer page 0x{FLASH_BASE + TRAILER_PAGE * 64:08X}"
+            loader._log(f"Error: {result['error']}")
+            return result
+        loader.write_trailer(data, args.fw)
+
+    # Error counters of the target node(s).
+    if args.stats or args.reset_stats:
+        nodes = {args.uid: {}} if args.uid else targets or loader.search_nodes()
+        reset = [1] if args.reset_stats else []
+        all_stats = loader.query_targets(nodes, BOOT_GET_STATS, reset, struct.calcsize(STATS_FORMAT),
+                                         loader.parse_stats, lambda uid: loader.get_stats(uid, args.reset_stats))
+        for uid, stats in all_stats.items():
+            if stats is None:
+                loader._log(f"Node {uid} | no statistics (requires BOOT_GET_STATS)")
+            else:
+                loader._log(f"Node {uid} | " + ", ".join(f"{k}: {v}" for k, v in stats.items()))
+
+    # Handle Standalone Search (Accepts value from --search)
+    if args.search is not None and args.verify is None:
+        slot_count = args.search
+        nodes = loader.search_nodes(slot_count)
+        result['nodes'] = max(result['nodes'], len(nodes))
+        for u, inf in nodes.items():
+            loader._log(f"UID: {u} | Node-ID: {inf['node_id']} | FW-ID: {inf['fw']}")
+
+    if args.run and not result['error']:
+        loader.start_app()
+    elif args.fast_baud:
+        # Leave the nodes on the default baudrate for the next session.
+        loader.set_baud(DEFAULT_BAUD)
+    return result
+
+
+def run_buses(args, data, blank=()):
+    """
+    One session per port, all buses at the same time. Each bus has its own
+    loader and reader thread, total time is that of the slowest bus.
+    """
+    console = BusConsole()
+    results = {}
+
+    def session(port):
+        started = time.perf_counter()
+        try:
+            loader = CH32V003Bootloader(port, args.baud, verbose=True, console=console)
+            if not hasattr(loader, 'thread'):
+                raise serial.SerialException("can not open port")
+            try:
+                results[port] = run_bus(loader, args, data, blank)
+            finally:
+                loader.close()
+        except Exception as e:
+            results[port] = {'port': port, 'nodes': 0, 'failed': 0, 'error': str(e), 'times': {}}
+            console.log(port, f"Error: {e}")
+        results[port]['times']['total'] = time.perf_counter() - started
+
+    start_time = time.perf_counter()
+    threads = [threading.Thread(target=session, args=(port,)) for port in args.port]
+    for t in threads:
+        t.start()
+    for t in threads:
+        t.join()
+    elapsed = time.perf_counter() - start_time
+
+    print("")
+    print(f"{'Port':<20} | {'Nodes':>5} | {'Detect':>7} | {'Write':>7} | {'Verify':>7} | {'Total':>7} | Status")
+    print("-" * 80)
+    for port in args.port:
+        res = results[port]
+        times = [f"{res['times'][s]:6.1f}s" if s in res['times'] else f"{'-':>7}"
+                 for s in ('detect', 'write', 'verify', 'total')]
+        if res['error']:
+            status = f"ERROR {res['error']}"
+        else:
+            status = f"{res['failed']} FAIL" if res['failed'] else "OK"
+        print(f"{port:<20} | {res['nodes']:>5} | {' | '.join(times)} | {status}")
+    sequential = sum(res['times']['total'] for res in results.values())
+    print(f"{len(args.port)} buses in {elapsed:.1f}s, {sequential:.1f}s one bus after the other")
+    return list(results.values())
+
+
 def main():
     parser = argparse.ArgumentParser(description='CH32V003 Bootloader Tool')
-    parser.add_argument('--port', '-p', default='COM13')
+    parser.add_argument('--port', '-p', action='append', help='Serial port, repeat for several buses updated at the same time (default COM13)')
     parser.add_argument('--baud', '-b', type=int, default=9600)
     parser.add_argument('--uid', help='Target UID')
-    parser.add_argument('-i', '--file', help='Firmware file')
+    parser.add_argument('-i', '--file', help='Firmware file, raw binary, Intel HEX (.hex) or ELF')
     parser.add_argument('--fw', type=int, default=0)
     
     # Use "nargs='?'" to make the value optional but immediately following the flag
@@ -324,51 +1779,59 @@ def main():
     
     parser.add_argument('--write', action='store_true', help='Write firmware using -i file')
     parser.add_argument('--run', action='store_true', help='Start application')
+    parser.add_argument('--trailer', action='store_true', help='Write the application length and CRC32 trailer after --write (automatic when --detect finds BOOT_FEATURE_APP_CHECK)')
+    parser.add_argument('--no-sync', action='store_true', help='Skip the sync hold, the nodes are already in the bootloader (BOOT_FEATURE_WARM_ENTRY)')
+    parser.add_argument('--fast-baud', type=int, help='Switch all nodes to this baudrate for the session (requires BOOT_SET_BAUD)')
+    parser.add_argument('--detect', type=int, nargs='?', const=63, help='Search the bus and use features supported by all nodes. Optional: slot size (default 63)')
+    parser.add_argument('--erase-all', action='store_true', help='Erase the whole application (requires BOOT_ERASE range support)')
+    parser.add_argument('--delta', action='store_true', help='Only write blocks that differ (requires --uid or --detect and BOOT_GET_CRC_MAP)')
+    parser.add_argument('--stats', action='store_true', help='Print node error counters (requires BOOT_GET_STATS)')
+    parser.add_argument('--reset-stats', action='store_true', help='Reset node error counters after reading them')
+    parser.add_argument('--dry-run', type=int, metavar='NODES', help='Estimate the session time for NODES nodes per bus, nothing is sent')
+    parser.add_argument('--caps', type=lambda v: int(v, 0), default=BOOT_CAP_ALL, help='Node capabilities assumed by --dry-run (default all)')
 
     args = parser.parse_args()
-    loader = CH32V003Bootloader(args.port, args.baud, verbose=True)
+    args.port = args.port or ['COM13']
 
-    try:
-        loader.enter_bootloader()
-        
-        # Handle Writing firmware
-        if args.write:
-            if not args.file:
-                print("Error: -i (file) is required for --write")
-                return
-            with open(args.file, 'rb') as f:
-                loader.update_firmware(f.read(), args.fw)
-
-        # Handle Verification (Accepts value from --verify)
-        if args.verify is not None:
-            if not args.file:
-                print("Error: -i (file) is required for --verify")
-                return
-            
-            slot_count = args.verify # This will be the number after 
-            targets = [args.uid] if args.uid else [u for u, inf in loader.search_nodes(slot_count).items() if inf['fw'] == args.fw]
-            
-            with open(args.file, 'rb') as f:
-                data = f.read()
-                expected = binascii.crc32(data) & 0xFFFFFFFF
-                for uid in targets:
-                    res = loader.get_verify_crc(uid, len(data))
-                    status = "MATCH" if res == expected else "FAIL"
-                    print(f"Node {uid} | Expected: 0x{expected:08X} | Node: {f'0x{res:08X}' if res else 'TIMEOUT'} | {status}")
-
-        # Handle Standalone Search (Accepts value from --search)
-        if args.search is not None and args.verify is None:
-            slot_count = args.search
-            nodes = loader.search_nodes(slot_count)
-            for u, inf in nodes.items():
-                print(f"UID: {u} | Node-ID: {inf['node_id']} | FW-ID: {inf['fw']}")
-
-        if args.run:
-            loader.start_app()
-    finally:
-        loader.close()
+    if (args.write or args.verify is not None) and not args.file:
+        print(f"Error: -i (file) is required for {'--write' if args.write else '--verify'}")
+        return
+    if args.uid and len(args.port) > 1:
+        print("Error: --uid selects one node, use a single --port")
+        return
+    if args.fast_baud and not BRR_MIN <= round(NODE_CLOCK_HZ / args.fast_baud) <= BRR_MAX:
+        print(f"Error: --fast-baud {args.fast_baud} out of range, "
+              f"{NODE_CLOCK_HZ // BRR_MAX + 1}..{NODE_CLOCK_HZ // BRR_MIN} bps")
+        return 1
+
+    data, blank = b'', set()
+    if args.file:
+        try:
+            data, blank = load_image(args.file)
+        except ValueError as e:
+            print(f"Error: {args.file}: {e}")
+            return 1
+
+    if args.dry_run is not None:
+        times = estimate_session(data, args.dry_run, args.caps, args, blank)
+        print(f"Estimate for {args.dry_run} node(s) per bus, caps 0x{args.caps:08X}, {args.baud} bps"
+              + (f" / {args.fast_baud} bps" if args.fast_baud else ""))
+        for step, seconds in times.items():
+            print(f"{step:<8} {seconds:7.2f}s")
+        if len(args.port) > 1:
+            print(f"{len(args.port)} buses at the same time, {times['total']:.2f}s")
+        return
+
+    if len(args.port) > 1:
+        results = run_buses(args, data, blank)
+    else:
+        loader = CH32V003Bootloader(args.port[0], args.baud, verbose=True)
+        try:
+            results = [run_bus(loader, args, data, blank)]
+        finally:
+            loader.close()
+    # Non-zero exit when any bus failed, scripts and CI see an incomplete update.
+    return 1 if any(res['error'] or res['failed'] for res in results) else 0
         
 if __name__ == "__main__":
-    main()
-    
-    
\ No newline at end of file
+    sys.exit(main())